@@ -0,0 +1,82 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "linker/Archive.h"
+
+bool getArgs(int argc, char **argv, std::string &outfile, std::vector<std::string> &infiles)
+{
+    int opt;
+    while((opt=getopt(argc, argv, "o:"))!=-1)
+    {
+        if(opt=='?')
+        {
+            std::cerr<< "Format "<<argv[0]<<" [-o OUTPUT_FILE] input_files...\n";
+            std::cerr<<"Arguments:\n-o OUTPUT_FILE_NAME (optional, default lib.a)";
+            return false;
+        }
+        switch(opt)
+        {
+            case 'o':
+                outfile=optarg;
+                break;
+            default:
+                break;
+        }
+    }
+    if(argc<=optind)
+    {
+        std::cerr<<"No input files given\n";
+        return false;
+    }
+    for(int i=optind;i<argc;i++)
+    {
+        infiles.push_back(argv[i]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outfile="lib.a";
+    std::vector<std::string> infiles;
+    if(!getArgs(argc, argv, outfile, infiles))
+    {
+        return -1;
+    }
+    Archive archive;
+    for(auto &infile:infiles)
+    {
+        std::ifstream ifs(infile);
+        if(ifs.fail())
+        {
+            std::cerr<<"Failed to open file "<<infile<<"\n";
+            return -1;
+        }
+        std::stringstream contents;
+        contents<<ifs.rdbuf();
+        auto memberName=infile.substr(infile.find_last_of('/')+1);
+        if(!archive.addMember(memberName, contents.str()))
+        {
+            for(const auto &error:archive.getErrors())
+            {
+                std::cerr<<error<<"\n";
+            }
+            return -1;
+        }
+    }
+    std::ofstream ofs(outfile, std::ios_base::out);
+    if(ofs.fail())
+    {
+        std::cerr<<"Failed to open output file "<<outfile<<"\n";
+        return -1;
+    }
+    archive.write(ofs);
+    return 0;
+}
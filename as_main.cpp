@@ -1,27 +1,82 @@
 #include <iostream>
-#include <regex>
+#include <sstream>
 #include <string>
 #include <fstream>
+#include <vector>
 #include <unistd.h>
 #include <cstdint>
 
 #include "assembler/File.h"
 #include "assembler/Assembler.h"
+#include "assembler/Optimizer.h"
+#include "common/ThreadPool.h"
+#include "common/Cache.h"
 
+struct Options
+{
+    uint16_t startAddress=16;
+    std::string outfile;
+    std::string outdir;
+    bool fragments=false;
+    bool singlePass=false;
+    bool raw=false;
+    bool optimize=false;
+    bool shortEncodings=false;
+    bool lineTable=false;
+    bool listing=false;
+    std::string cacheDir=Cache::defaultDirectory();
+    unsigned jobs=0;
+};
 
-bool getArgs(int argc, char **argv, uint16_t &startAddress, std::string &outfile, std::string &infile)
+bool getArgs(int argc, char **argv, Options &options, std::vector<std::string> &infiles)
 {
     int opt;
-    while((opt=getopt(argc, argv, "s:o:"))!=-1)
+    while((opt=getopt(argc, argv, "s:o:d:j:c:f12bOSgl"))!=-1)
     {
         if(opt=='?')
         {
-            std::cerr<< "Format "<<argv[0]<<" [-o OUTPUT_FILE][-s START_ADDRESS] input_file\n";
-            std::cerr<<"Arguments:\n-o OUTPUT_FILE_NAME (optional, default a.o)\n-s START_ADDRESS (optional, default 0)";
+            std::cerr<< "Format "<<argv[0]<<" [-o OUTPUT_FILE | -d OUTPUT_DIR][-s START_ADDRESS][-f][-1 | -2][-b][-O][-S][-g][-l][-c CACHE_DIR][-j JOBS] input_files...\n";
+            std::cerr<<"Arguments:\n-o OUTPUT_FILE_NAME (optional, default a.o, only for a single input file)";
+            std::cerr<<"\n-d OUTPUT_DIR (optional, writes DIR/name.o for every input name.s)\n-s START_ADDRESS (optional, default 0)";
+            std::cerr<<"\n-f (optional, emit per-function fragments for link-time garbage collection)";
+            std::cerr<<"\n-1 (optional, assemble in one pass, patching forward references at the end)";
+            std::cerr<<"\n-2 (optional, default, assemble in two passes)";
+            std::cerr<<"\n-b (optional, write section contents as raw bytes instead of hex)";
+            std::cerr<<"\n-O (optional, rewrite wasteful instruction sequences before encoding)";
+            std::cerr<<"\n-S (optional, encode small immediates and short jumps without a second word)";
+            std::cerr<<"\n-g (optional, emit a table of instruction addresses and source lines)";
+            std::cerr<<"\n-l (optional, write a listing with addresses, bytes and cost estimates to name.lst next to name.o)";
+            std::cerr<<"\n-c CACHE_DIR (optional, default $SS_CACHE_DIR, reuse objects of identical sources, $SS_CACHE_LIMIT bounds its size)";
+            std::cerr<<"\n-j JOBS (optional, default number of cores, files assembled concurrently)";
+            std::cerr<<"\nAn input file named - is read from standard input";
             return false;
         }
         switch(opt)
         {
+            case 'f':
+                options.fragments=true;
+                break;
+            case '1':
+                options.singlePass=true;
+                break;
+            case '2':
+                options.singlePass=false;
+                break;
+            case 'b':
+                options.raw=true;
+                break;
+            case 'O':
+                options.optimize=true;
+                break;
+            case 'S':
+                options.shortEncodings=true;
+                break;
+            case 'g':
+                options.lineTable=true;
+                break;
+            case 'l':
+                options.listing=true;
+                break;
             case 's':
             {
                 auto startAddr = atoi(optarg);
@@ -36,12 +91,29 @@ bool getArgs(int argc, char **argv, uint16_t &startAddress, std::string &outfile
                               << UINT16_MAX;
                     return false;
                 }
-                startAddress = (uint16_t) startAddr;
+                options.startAddress = (uint16_t) startAddr;
                 break;
             }
             case 'o':
-                outfile=optarg;
+                options.outfile=optarg;
+                break;
+            case 'c':
+                options.cacheDir=optarg;
                 break;
+            case 'd':
+                options.outdir=optarg;
+                break;
+            case 'j':
+            {
+                auto jobs = atoi(optarg);
+                if (jobs <= 0)
+                {
+                    std::cerr << "Number of jobs must be positive";
+                    return false;
+                }
+                options.jobs = (unsigned) jobs;
+                break;
+            }
             default:
                 break;
         }
@@ -51,65 +123,214 @@ bool getArgs(int argc, char **argv, uint16_t &startAddress, std::string &outfile
         std::cout <<"Please specify input file\n";
         return false;
     }
-    infile=argv[optind];
+    bool stdinUsed=false;
+    for(int i=optind;i<argc;i++)
+    {
+        if(std::string(argv[i])=="-")
+        {
+            if(stdinUsed)
+            {
+                std::cerr<<"Standard input can only be given once\n";
+                return false;
+            }
+            stdinUsed=true;
+        }
+        infiles.push_back(argv[i]);
+    }
+    if(!options.outfile.empty() && (infiles.size()>1 || !options.outdir.empty()))
+    {
+        std::cerr<<"-o can only be used with a single input file and without -d\n";
+        return false;
+    }
     return true;
 }
-int main(int argc, char **argv)
+
+// name.s -> OUTPUT_DIR/name.o, or name.o next to the input when there is no output directory
+std::string objectName(const std::string &infile, const Options &options)
 {
-    uint16_t startAddress=16;
-    std::string outfile="a.o";
-    std::string infile;
-    if(!getArgs(argc, argv, startAddress, outfile, infile))
-    {
-        return -1;
-    }
-    if(startAddress<WORD_SIZE*IVT_SIZE)
+    if(!options.outfile.empty()) return options.outfile;
+    if(infile=="-") return options.outdir.empty() ? "stdin.o" : options.outdir+"/stdin.o";
+    auto slash=infile.find_last_of('/');
+    auto base=slash==std::string::npos ? infile : infile.substr(slash+1);
+    auto dot=base.find_last_of('.');
+    if(dot!=std::string::npos && dot>0) base=base.substr(0, dot);
+    if(!options.outdir.empty()) return options.outdir+"/"+base+".o";
+    return (slash==std::string::npos ? "" : infile.substr(0, slash+1))+base+".o";
+}
+
+// Source content, start address, assembler version and every option that changes the object.
+// Standard input and listings are never cached.
+bool cacheKey(const std::string &infile, const Options &options, CacheKey &key)
+{
+    if(infile=="-" || options.listing) return false;
+    key.add(std::string("ssas"));
+    key.add((uint64_t)ASSEMBLER_VERSION);
+    key.add((uint64_t)options.startAddress);
+    key.add((uint64_t)(options.fragments | options.singlePass<<1u | options.raw<<2u | options.optimize<<3u |
+                       options.shortEncodings<<4u | options.lineTable<<5u));
+    if(options.lineTable) key.add(infile);
+    return key.addFile(infile);
+}
+
+bool copyFile(const std::string &from, const std::string &to)
+{
+    std::ifstream ifs(from, std::ios_base::in | std::ios_base::binary);
+    if(ifs.fail()) return false;
+    std::ofstream ofs(to, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    ofs<<ifs.rdbuf();
+    return !ofs.fail();
+}
+
+bool readFile(const std::string &fileName, std::string &contents)
+{
+    std::ifstream ifs(fileName, std::ios_base::in | std::ios_base::binary);
+    if(ifs.fail()) return false;
+    std::ostringstream oss;
+    oss<<ifs.rdbuf();
+    contents=oss.str();
+    return !ifs.bad();
+}
+
+void storeEntry(const Cache &cache, const CacheKey &key, const std::string &entry, const std::string &contents)
+{
+    auto temporary=cache.temporaryPath(key);
+    std::ofstream tmp(temporary, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    tmp<<contents;
+    tmp.close();
+    if(!tmp.fail()) cache.publish(temporary, entry);
+    else unlink(temporary.c_str());
+}
+
+// A cached object comes with the warnings and reports printed when it was
+// assembled, in a .log entry that is published first and replayed on a hit
+bool assemble(const std::string &infile, const std::string &outfile, const Options &options,
+              const Cache &cache, std::ostream &diagnostics)
+{
+    CacheKey key;
+    bool cached=cache.isEnabled() && cacheKey(infile, options, key);
+    auto entry=cached ? cache.entryPath(key, ".o") : "";
+    auto logEntry=cached ? cache.entryPath(key, ".log") : "";
+    std::string log;
+    if(cached && readFile(logEntry, log) && copyFile(entry, outfile))
     {
-        std::cerr<<"Warning: program will overlap with IV table\n";
+        cache.touch(entry);
+        cache.touch(logEntry);
+        diagnostics<<log<<"Compile successful (cached)\n";
+        return true;
     }
-    std::ifstream ifs(infile,std::ios_base::in);
-    File f(ifs, infile);
-    ifs.close();
+    File f(infile);
     if(!f.isValid())
     {
         for (const auto &message:f.getErrors())
         {
-            std::cerr<<message<<"\n";
+            diagnostics<<message<<"\n";
+        }
+        return false;
+    }
+    Assembler as(f, options.startAddress);
+    as.setFragments(options.fragments);
+    as.setShortEncodings(options.shortEncodings);
+    as.setLineTable(options.lineTable);
+    as.setListing(options.listing);
+    Optimizer optimizer;
+    std::ostringstream report;
+    if(options.optimize)
+    {
+        if(optimizer.optimize(f.getLines())) as.setLines(optimizer.getLines());
+        for(const auto &warning:optimizer.getWarnings())
+        {
+            report<<warning<<"\n";
         }
-        return -1;
     }
-    std::ofstream ofs(outfile, std::ios_base::out);
-    Assembler as(f, startAddress);
-    if(!as.firstPass() || !as.secondPass())
+    bool assembled=options.singlePass ? as.singlePass() : as.firstPass() && as.secondPass();
+    if(!assembled)
     {
-        std::cerr<<"Assembly failed\n";
+        diagnostics<<report.str()<<"Assembly failed\n";
         for(const auto &error:as.getErrors())
         {
-            std::cerr<<error<<"\n";
+            diagnostics<<error<<"\n";
         }
-        std::cerr<<as.getErrors().size()/2<<" errors\n";
-        return -1;
+        diagnostics<<as.getErrors().size()/2<<" errors\n";
+        return false;
+    }
+    std::ofstream ofs(outfile, std::ios_base::out | std::ios_base::binary);
+    if(ofs.fail())
+    {
+        diagnostics<<report.str()<<"Failed to open output file "<<outfile<<"\n";
+        return false;
     }
-    else if(!ofs.fail())
+    if(!as.getWarnings().empty())
     {
-        if(!as.getWarnings().empty())
+        for(const auto &warning:as.getWarnings())
         {
-            for(const auto &warning:as.getWarnings())
-            {
-                std::cerr<<warning<<"\n";
-            }
-            std::cerr<<"Warnings exist\n";
+            report<<warning<<"\n";
         }
-        std::cerr<<"Compile successful\n";
-        ofs<<"START: "<<startAddress<<"\n";
-        as.outputSymbolTable(ofs);
-        as.outputRelocationTable(ofs);
-        as.outputCode(ofs, false);
-        return 0;
+        report<<"Warnings exist\n";
+    }
+    if(options.optimize)
+    {
+        report<<"Optimizer removed "<<optimizer.getRemovedInstructions()<<" instructions, "
+              <<optimizer.getSavedBytes()<<" bytes\n";
+    }
+    if(options.shortEncodings)
+    {
+        report<<"Short encodings saved "<<as.getShortenedInstructions()*WORD_SIZE<<" bytes\n";
     }
-    else
+    diagnostics<<report.str()<<"Compile successful\n";
+    std::ostringstream object;
+    as.outputObject(object, options.raw);
+    ofs<<object.str();
+    if(cached)
+    {
+        storeEntry(cache, key, logEntry, report.str());
+        storeEntry(cache, key, entry, object.str());
+    }
+    if(options.listing)
+    {
+        auto listingFile=outfile.size()>2 && outfile.compare(outfile.size()-2, 2, ".o")==0 ?
+                         outfile.substr(0, outfile.size()-2)+".lst" : outfile+".lst";
+        std::ofstream listing(listingFile);
+        if(listing.fail())
+        {
+            diagnostics<<"Failed to open listing file "<<listingFile<<"\n";
+            return false;
+        }
+        as.outputListing(listing);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    std::vector<std::string> infiles;
+    if(!getArgs(argc, argv, options, infiles))
     {
-        std::cerr <<"Failed to open output file";
         return -1;
     }
-}
\ No newline at end of file
+    if(infiles.size()==1 && options.outfile.empty() && options.outdir.empty())
+    {
+        options.outfile="a.o";
+    }
+    if(options.startAddress<WORD_SIZE*IVT_SIZE)
+    {
+        std::cerr<<"Warning: program will overlap with IV table\n";
+    }
+    std::vector<std::ostringstream> diagnostics(infiles.size());
+    std::vector<char> results(infiles.size());
+    Cache cache(options.cacheDir);
+    ThreadPool pool(options.jobs);
+    pool.run(infiles.size(), [&](size_t i)
+    {
+        results[i]=assemble(infiles[i], objectName(infiles[i], options), options, cache, diagnostics[i]);
+    });
+    cache.trim(Cache::defaultLimit());
+    bool success=true;
+    for(size_t i=0;i<infiles.size();i++)
+    {
+        if(infiles.size()>1) std::cerr<<infiles[i]<<":\n";
+        std::cerr<<diagnostics[i].str();
+        success&=results[i]!=0;
+    }
+    return success ? 0 : -1;
+}
@@ -1,25 +1,143 @@
+#include <algorithm>
+#include <cstring>
 #include <sstream>
-#include <regex>
 #include <iomanip>
 #include "Assembler.h"
-
-std::regex SYMBOL_NAME(R"(^[A-Za-z_][A-Za-z_0-9]*$)");
+#include "Lexer.h"
+#include "../common/StringTable.h"
+#include "../emulator/CostModel.h"
 
 Assembler::Assembler(const File &file, uint16_t startAddress)
-        : file(file), startAddress(startAddress), code(nullptr),
-          baseCode(nullptr)
+        : code(nullptr), baseCode(nullptr), file(file), lines(&file.getLines()), startAddress(startAddress),
+          currentSection(StringTable::UNKNOWN), fragments(false), onePass(false), shortEncodings(false),
+          shortened(0), lineTable(false), listing(false)
+{
+}
+
+Assembler::~Assembler()
+{
+    delete[] baseCode;
+}
+
+void Assembler::setFragments(bool fragments)
+{
+    Assembler::fragments = fragments;
+}
+
+void Assembler::setShortEncodings(bool shortEncodings)
+{
+    Assembler::shortEncodings = shortEncodings;
+}
+
+void Assembler::setLineTable(bool lineTable)
+{
+    Assembler::lineTable = lineTable;
+}
+
+void Assembler::setListing(bool listing)
+{
+    Assembler::listing = listing;
+}
+
+void Assembler::setLines(const std::vector<Line> &lines)
 {
+    Assembler::lines = &lines;
 }
 
 bool Assembler::firstPass()
+{
+    shortJumps.clear();
+    if (!scanFirst()) return false;
+    if (!shortEncodings || fragments) return true;
+    // Lay the code out again until no jump changes size. Jumps may grow back
+    // while shrinking, after MAX_SHRINK_ITERATIONS they only grow, which ends.
+    for (int iteration = 0; ; iteration++)
+    {
+        bool resized;
+        if (!relaxJumps(resized, iteration < MAX_SHRINK_ITERATIONS)) return false;
+        if (!resized) return true;
+        if (!scanFirst()) return false;
+    }
+}
+
+bool Assembler::scanFirst()
 {
     symbolTable.clear();
     errors.clear();
+    jumpSites.clear();
     locationCounter = startAddress;
-    currentSection = "";
+    currentSection = StringTable::UNKNOWN;
     running = true;
+    return scanLines(true);
+}
+
+// jmp $label becomes add pc, n without a second word when the label is in
+// the same section and its offset is one of the short immediates
+bool Assembler::relaxJumps(bool &resized, bool shrink)
+{
+    resized = false;
+    for (auto &site:jumpSites)
+    {
+        uint8_t field = 0;
+        auto current = shortJumps.find(site.line);
+        auto iter = symbolTable.find(site.symbol.str());
+        if (iter != symbolTable.end() && iter->second.getType() == Symbol::LABEL &&
+            iter->second.getSectionId() == site.section)
+        {
+            // A label after the jump moves with it when the jump changes size
+            int target = iter->second.getOffset();
+            int size = current == shortJumps.end() ? 4 : 2;
+            field = shortImmediate(target - site.location - (target > site.location ? size : 2));
+        }
+        if (current == shortJumps.end())
+        {
+            if (field == 0 || !shrink) continue;
+            shortJumps[site.line] = field;
+            resized = true;
+        }
+        else if (field == 0)
+        {
+            shortJumps.erase(current);
+            resized = true;
+        }
+        else
+        {
+            current->second = field;
+        }
+    }
+    return true;
+}
+
+// Short jumps need the final offset of every label before anything is
+// encoded, only the relaxation over first passes knows them, so with short
+// encodings this is the two pass assembly
+bool Assembler::singlePass()
+{
+    if (shortEncodings) return firstPass() && secondPass();
+    shortened = 0;
+    sourceLines.clear();
+    listingLines.clear();
+    symbolTable.clear();
+    errors.clear();
+    fixups.clear();
+    globalNames.clear();
+    transferEnds.clear();
+    delete[] baseCode;
+    baseCode = new uint8_t[MEMORY_SIZE + 4]();
+    code = baseCode;
+    locationCounter = startAddress;
+    currentSection = StringTable::UNKNOWN;
+    running = true;
+    onePass = true;
+    bool result = scanLines(false);
+    onePass = false;
+    return result && resolveFixups();
+}
+
+bool Assembler::scanLines(bool firstPass)
+{
     bool stillDoingGlobals = true;
-    for (auto &line:file.getLines())
+    for (auto &line:*lines)
     {
         if (!running) break;
         currentLine = line.getNumber();
@@ -40,6 +158,7 @@ bool Assembler::firstPass()
         {
             stillDoingGlobals = false;
         }
+        auto location = locationCounter;
         switch (line.getType())
         {
             case Line::DOT_DIRECTIVE:
@@ -50,16 +169,52 @@ bool Assembler::firstPass()
                             line.getNumber());
                     return false;
                 }
-                if (!handleDot(line, true)) return false;
+                if (!handleDot(line, firstPass)) return false;
                 break;
             case Line::INSTRUCTION:
-                if (!handleInstruction(line, true)) return false;
+                if (!handleInstruction(line, firstPass)) return false;
                 break;
             case Line::LABEL_ONLY:
             case Line::EMPTY:
             default:
                 break;
         }
+        if (!firstPass) recordListing(line, location);
+    }
+    return true;
+}
+
+void Assembler::recordListing(const Line &line, uint32_t location)
+{
+    if (!listing) return;
+    listingLines.push_back({&line, (uint16_t) location, (uint16_t) (locationCounter - location), currentSection});
+}
+
+// Finishes a single pass the way the second pass would: globals are
+// resolved against the complete symbol table and every deferred symbol
+// reference is patched or turned into a relocation, in source order.
+bool Assembler::resolveFixups()
+{
+    if (fragments) computeFragments();
+    auto lastSection = currentSection;
+    for (auto &name:globalNames)
+    {
+        declareSymbol(name, false, true);
+    }
+    for (auto &fixup:fixups)
+    {
+        currentSection = fixup.section;
+        currentLine = fixup.line;
+        if (!putSymbol(fixup.symbol, fixup.relative, fixup.location, fixup.length))
+        {
+            return false;
+        }
+    }
+    currentSection = lastSection;
+    if(currentSection!=StringTable::UNKNOWN)
+    {
+        auto &oldSection=symbolTable[StringTable::lookup(currentSection)];
+        oldSection.setLength(locationCounter-oldSection.getOffset());
     }
     return true;
 }
@@ -67,19 +222,25 @@ bool Assembler::firstPass()
 bool Assembler::secondPass()
 {
     errors.clear();
+    shortened = 0;
+    sourceLines.clear();
+    listingLines.clear();
     delete[] baseCode;
     if (locationCounter - startAddress > 0)
     {
-        baseCode = new uint8_t[locationCounter - startAddress];
+        baseCode = new uint8_t[locationCounter - startAddress]();
         code = baseCode - startAddress;
     }
+    if (fragments) computeFragments();
+    transferEnds.clear();
     locationCounter = startAddress;
-    currentSection = "";
+    currentSection = StringTable::UNKNOWN;
     running = true;
-    for (auto &line:file.getLines())
+    for (auto &line:*lines)
     {
         if (!running) break;
         currentLine = line.getNumber();
+        auto location = locationCounter;
         switch (line.getType())
         {
             case Line::DOT_DIRECTIVE:
@@ -93,10 +254,11 @@ bool Assembler::secondPass()
             default:
                 break;
         }
+        recordListing(line, location);
     }
-    if(!currentSection.empty())
+    if(currentSection!=StringTable::UNKNOWN)
     {
-        auto &oldSection=symbolTable[currentSection];
+        auto &oldSection=symbolTable[StringTable::lookup(currentSection)];
         oldSection.setLength(locationCounter-oldSection.getOffset());
     }
     return true;
@@ -104,9 +266,14 @@ bool Assembler::secondPass()
 
 bool Assembler::declareSymbol(std::string name, bool firstPass, bool global)
 {
-    if (firstPass)
+    if (firstPass || onePass)
     {
-        if (!global)
+        if (global)
+        {
+            declaredGlobals.insert(name);
+            globalNames.push_back(name);
+        }
+        else
         {
             if (symbolTable.count(name) != 0)
             {
@@ -118,7 +285,7 @@ bool Assembler::declareSymbol(std::string name, bool firstPass, bool global)
                 emmitError("Cannot declare symbol with reserved name " + name);
                 return false;
             }
-            if (currentSection.empty())
+            if (currentSection == StringTable::UNKNOWN)
             {
                 emmitError("Cannot declare symbol " + name +
                            " outside of section");
@@ -139,7 +306,7 @@ bool Assembler::declareSymbol(std::string name, bool firstPass, bool global)
         else
         {
             symbolTable.insert({name,
-                                Symbol(name, Symbol::LABEL, "UNKNOWN", 0, true,
+                                Symbol(name, Symbol::LABEL, StringTable::UNKNOWN, 0, true,
                                        symbolTable.size(), 0)});
         }
     }
@@ -148,88 +315,261 @@ bool Assembler::declareSymbol(std::string name, bool firstPass, bool global)
 
 bool Assembler::handleDot(const Line &line, bool firstPass)
 {
-    if (line.getDirective() == ".end")
+    auto handler = findDirective(line.getDirective());
+    if (handler == nullptr)
     {
-        running = false;
-        return true;
-    }
-    if (dotHandlers.count(line.getDirective()))
-    {
-        return dotHandlers[line.getDirective()](*this, line, firstPass);
-    }
-    else
-    {
-        return dotHandlers[".section"](*this, line, firstPass);
+        handler = dotSectionHandler;
     }
+    return handler(*this, line, firstPass);
 }
 
 bool Assembler::handleInstruction(const Line &line, bool firstPass)
 {
-    if (currentSection.empty())
+    if (currentSection == StringTable::UNKNOWN)
     {
         emmitError("Cannot put instructions outside of section",
                    line.getNumber());
         return false;
     }
-    if (currentSection == ".bss")
+    if (currentSection == StringTable::BSS)
     {
         emmitError("Cannot put instructions in bss of section",
                    line.getNumber());
         return false;
     }
-    std::string instruction = line.getInstruction();
-    std::string condition;
-    auto location = locationCounter;
-    for (auto ins:instructionHandlers)
+    const auto &token = line.getInstruction();
+    uint8_t cnd;
+    auto mnemonic = decodeMnemonic(token, cnd);
+    if (mnemonic == nullptr)
     {
-        if (ins.first + "eq" == instruction || ins.first + "ne" == instruction
-            || ins.first + "gt" == instruction ||
-            ins.first + "al" == instruction)
+        std::string instruction = token;
+        std::transform(instruction.begin(), instruction.end(), instruction.begin(),
+                       [](char c) { return tolower(c); });
+        emmitError("Unknown instruction " + instruction,
+                   line.getNumber());
+        return false;
+    }
+    auto location = locationCounter;
+    auto result = mnemonic->handler(*this, Line(line, mnemonic->name), firstPass);
+    if (result && (!firstPass))
+    {
+        if (lineTable) sourceLines.push_back({currentSection, (uint16_t) location, line.getNumber()});
+        code[location] |= (cnd << 6u);
+        if (cnd == 3 && (mnemonic->handler == jmpInstructionHandler ||
+                         mnemonic->handler == retInstructionHandler ||
+                         mnemonic->handler == noargInstructionHandler ||
+                         ((mnemonic->opcode == MOV_OPCODE || mnemonic->opcode == POP_OPCODE) &&
+                          line.getArg0().getType() == Operand::REGISTER &&
+                          line.getArg0().getRegisterId() == PC_REGISTER)))
         {
-            condition = instruction.substr(instruction.length() - 2);
-            instruction = instruction.substr(0, instruction.length() - 2);
-            break;
+            transferEnds.insert(locationCounter);
         }
     }
-    if (instructionHandlers.count(instruction) > 0)
-    {
-        auto result = instructionHandlers[instruction](*this,
-                                                       Line(line, instruction),
-                                                       firstPass);
-        if (result && (!firstPass))
+    return result;
+}
+
+const Assembler::Mnemonic *Assembler::decodeMnemonic(const StringRef &token, uint8_t &condition)
+{
+    auto length = token.length();
+    const Mnemonic *mnemonic = nullptr;
+    condition = 3;
+    if (length <= MAX_MNEMONIC_LENGTH)
+    {
+        char lower[MAX_MNEMONIC_LENGTH];
+        std::transform(token.begin(), token.end(), lower, [](char c) { return tolower(c); });
+        if (length > 2)
         {
-            uint8_t cnd = 3;
-            if (!condition.empty())
+            condition = conditionCode(lower[length - 2], lower[length - 1]);
+            if (condition != NO_CONDITION)
             {
-                if (condition == "eq") cnd = 0;
-                else if (condition == "ne") cnd = 1;
-                else if (condition == "gt") cnd = 2;
-                else cnd = 3;
+                mnemonic = findMnemonic(lower, length - 2);
             }
-            code[location] |= (cnd << 6u);
-            return true;
         }
-        else return result;
+        if (mnemonic == nullptr)
+        {
+            condition = 3;
+            mnemonic = findMnemonic(lower, length);
+        }
     }
-    else
+    return mnemonic;
+}
+
+const char *Assembler::decodeInstruction(const StringRef &token, uint8_t &condition)
+{
+    auto mnemonic = decodeMnemonic(token, condition);
+    return mnemonic == nullptr ? nullptr : mnemonic->name;
+}
+
+uint8_t Assembler::conditionCode(char first, char second)
+{
+    switch ((first << 8) | second)
+    {
+        case ('e' << 8) | 'q':
+            return 0;
+        case ('n' << 8) | 'e':
+            return 1;
+        case ('g' << 8) | 't':
+            return 2;
+        case ('a' << 8) | 'l':
+            return 3;
+        default:
+            return NO_CONDITION;
+    }
+}
+
+const Assembler::Mnemonic *Assembler::findMnemonic(const char *token, size_t length)
+{
+    int index = -1;
+    switch (length)
     {
-        emmitError("Unknown instruction " + line.getInstruction(),
-                   line.getNumber());
-        return false;
+        case 2:
+            index = 6;
+            break;
+        case 3:
+            switch (token[0])
+            {
+                case 'a':
+                    index = token[1] == 'd' ? 0 : 5;
+                    break;
+                case 's':
+                    index = token[1] == 'u' ? 1 : (token[2] == 'l' ? 12 : 13);
+                    break;
+                case 'm':
+                    index = token[1] == 'u' ? 2 : 11;
+                    break;
+                case 'd':
+                    index = 3;
+                    break;
+                case 'c':
+                    index = 4;
+                    break;
+                case 'n':
+                    index = 7;
+                    break;
+                case 'p':
+                    index = 15;
+                    break;
+                case 'r':
+                    index = 16;
+                    break;
+                case 'j':
+                    index = 17;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case 4:
+            switch (token[0])
+            {
+                case 't':
+                    index = 8;
+                    break;
+                case 'p':
+                    if (token[1] == 'u') index = 9;
+                    else if (token[1] == 'a') index = 20;
+                    else if (token[1] == 's') index = 21;
+                    else index = token[2] == 'i' ? 23 : 24;
+                    break;
+                case 'c':
+                    index = 10;
+                    break;
+                case 'i':
+                    index = 14;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case 5:
+            index = 25;
+            break;
+        case 6:
+            if (token[0] == 'p') index = 22;
+            else index = token[3] == 'm' ? 18 : 19;
+            break;
+        default:
+            break;
     }
+    if (index < 0 || memcmp(mnemonics[index].name, token, length) != 0) return nullptr;
+    return &mnemonics[index];
+}
+
+uint8_t Assembler::opcodeOf(const StringRef &instruction)
+{
+    return findMnemonic(instruction.data(), instruction.length())->opcode;
+}
+
+Assembler::DotHandler Assembler::findDirective(const StringRef &directive)
+{
+    const char *name = nullptr;
+    DotHandler handler = nullptr;
+    switch (directive.length())
+    {
+        case 4:
+            name = ".end";
+            handler = dotEndHandler;
+            break;
+        case 5:
+            switch (directive[1])
+            {
+                case 'c':
+                    name = ".char";
+                    handler = dotCharHandler;
+                    break;
+                case 'w':
+                    name = ".word";
+                    handler = dotWordHandler;
+                    break;
+                case 'l':
+                    name = ".long";
+                    handler = dotLongHandler;
+                    break;
+                case 's':
+                    name = ".skip";
+                    handler = dotSkipHandler;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case 6:
+            name = ".align";
+            handler = dotAlignHandler;
+            break;
+        case 7:
+            name = ".global";
+            handler = dotGlobalHandler;
+            break;
+        case 8:
+            name = ".section";
+            handler = dotSectionHandler;
+            break;
+        default:
+            break;
+    }
+    if (name == nullptr || directive != name) return nullptr;
+    return handler;
+}
+
+bool Assembler::dotEndHandler(Assembler &assembler, const Line &line,
+                              bool firstPass)
+{
+    assembler.running = false;
+    return true;
 }
 
 bool Assembler::dotCharHandler(Assembler &assembler, const Line &line,
                                bool firstPass)
 {
-    if (assembler.currentSection.empty())
+    if (assembler.currentSection == StringTable::UNKNOWN)
     {
         assembler.emmitError("Cannot declare data outside of section",
                              line.getNumber());
         return false;
     }
     const auto &arg = line.getDotArg();
-    if (std::regex_match(arg, SYMBOL_NAME))
+    if (Lexer::isIdentifier(arg, 0, arg.length()))
     {
         if (!firstPass)
         {
@@ -263,14 +603,14 @@ bool Assembler::dotCharHandler(Assembler &assembler, const Line &line,
 bool Assembler::dotWordHandler(Assembler &assembler, const Line &line,
                                bool firstPass)
 {
-    if (assembler.currentSection.empty())
+    if (assembler.currentSection == StringTable::UNKNOWN)
     {
         assembler.emmitError("Cannot declare data outside of section",
                              line.getNumber());
         return false;
     }
     const auto &arg = line.getDotArg();
-    if (std::regex_match(arg, SYMBOL_NAME))
+    if (Lexer::isIdentifier(arg, 0, arg.length()))
     {
         if (!firstPass)
         {
@@ -302,14 +642,14 @@ bool Assembler::dotWordHandler(Assembler &assembler, const Line &line,
 bool Assembler::dotLongHandler(Assembler &assembler, const Line &line,
                                bool firstPass)
 {
-    if (assembler.currentSection.empty())
+    if (assembler.currentSection == StringTable::UNKNOWN)
     {
         assembler.emmitError("Cannot declare data outside of section",
                              line.getNumber());
         return false;
     }
     const auto &arg = line.getDotArg();
-    if (std::regex_match(arg, SYMBOL_NAME))
+    if (Lexer::isIdentifier(arg, 0, arg.length()))
     {
         if (!firstPass)
         {
@@ -466,7 +806,8 @@ void Assembler::emmitWarning(const std::string &message, int line)
 
 bool Assembler::declareSection(std::string name, bool firstPass)
 {
-    if (firstPass)
+    auto section = StringTable::intern(name);
+    if (firstPass || onePass)
     {
         if (symbolTable.count(name) != 0)
         {
@@ -474,15 +815,15 @@ bool Assembler::declareSection(std::string name, bool firstPass)
             return false;
         }
         symbolTable.insert({name,
-                            Symbol(name, Symbol::SECTION, name, locationCounter,
+                            Symbol(name, Symbol::SECTION, section, locationCounter,
                                    false, symbolTable.size(), 0)});
     }
-    if(!currentSection.empty())
+    if(currentSection!=StringTable::UNKNOWN)
     {
-        auto &oldSection=symbolTable[currentSection];
+        auto &oldSection=symbolTable[StringTable::lookup(currentSection)];
         oldSection.setLength(locationCounter-oldSection.getOffset());
     }
-    currentSection = name;
+    currentSection = section;
     return true;
 }
 
@@ -490,6 +831,11 @@ const std::vector<std::string> &Assembler::getErrors() const
 {
     return errors;
 }
+uint Assembler::getShortenedInstructions() const
+{
+    return shortened;
+}
+
 const std::vector<std::string> &Assembler::getWarnings() const
 {
     return warnings;
@@ -509,40 +855,32 @@ std::string binstr(uint8_t v)
     return bin;
 }
 
+static void appendField(std::string &buffer, const std::string &value, size_t width)
+{
+    buffer += value;
+    if (value.length() < width) buffer.append(width - value.length(), ' ');
+}
+
 void Assembler::outputSymbolTable(std::ostream &stream)
 {
-    stream << "SYMBOLS:\n";
-    stream
-            << "#         Name            Section         Offset          Length          Visibility\n";
-    std::vector<std::string> symbols(symbolTable.size());
-    for (auto symb:symbolTable)
+    std::string buffer = "SYMBOLS:\n";
+    buffer += "#         Name            Section         Offset          Length          Visibility\n";
+    std::vector<const Symbol *> symbols(symbolTable.size(), nullptr);
+    for (auto &symb:symbolTable)
     {
-        symbols[symb.second.getSeq()] = symb.second.getName();
+        symbols[symb.second.getSeq()] = &symb.second;
     }
-    auto flags = stream.flags();
-    for (auto &symbol:symbols)
-    {
-        stream << std::setw(10) << std::left;
-        stream << symbolTable[symbol].getSeq();
-        stream << std::setw(16) << std::left;
-        stream << symbolTable[symbol].getName();
-        stream << std::setw(16) << std::left;
-        stream << symbolTable[symbol].getSection();
-        stream << std::setw(16) << std::left;
-        stream << symbolTable[symbol].getOffset();
-        stream << std::setw(16) << std::left;
-        stream << symbolTable[symbol].getLength();
-        if (symbolTable[symbol].isGlobal())
-        {
-            stream << "GLOBAL";
-        }
-        else
-        {
-            stream << "LOCAL";
-        }
-        stream << "\n";
+    for (auto symbol:symbols)
+    {
+        if (symbol == nullptr) symbol = &symbolTable[""];
+        appendField(buffer, std::to_string(symbol->getSeq()), 10);
+        appendField(buffer, symbol->getName(), 16);
+        appendField(buffer, symbol->getSection(), 16);
+        appendField(buffer, std::to_string(symbol->getOffset()), 16);
+        appendField(buffer, std::to_string(symbol->getLength()), 16);
+        buffer += symbol->isGlobal() ? "GLOBAL\n" : "LOCAL\n";
     }
-    stream.flags(flags);
+    stream.write(buffer.data(), buffer.size());
 }
 
 bool Assembler::binaryInstructionHandler(Assembler &assembler, const Line &line,
@@ -573,15 +911,19 @@ bool Assembler::binaryInstructionHandler(Assembler &assembler, const Line &line,
     }
 
     int len = 2;
-    if (line.getArg0().getType() != Operand::OperandType::REGISTER
-        || line.getArg1().getType() != Operand::OperandType::REGISTER)
+    if (assembler.needsWord(line.getArg0()) || assembler.needsWord(line.getArg1()))
     {
         len += 2;
     }
+    else if (!firstPass && (line.getArg0().getType() != Operand::REGISTER ||
+                            line.getArg1().getType() != Operand::REGISTER))
+    {
+        assembler.shortened++;
+    }
     if (!firstPass)
     {
         assembler.code[assembler.locationCounter] =
-                opcodes[line.getInstruction()] << 2;
+                opcodeOf(line.getInstruction()) << 2;
         if (!assembler.emmitArguments(line, assembler.locationCounter))
             return false;
     }
@@ -605,10 +947,7 @@ bool Assembler::unaryInstructionHandler(Assembler &assembler, const Line &line,
                 line.getNumber());
         return false;
     }
-    auto instruction = line.getInstruction();
-    std::transform(instruction.begin(), instruction.end(), instruction.begin(),
-                   [](char c) { return tolower(c); });
-    if (instruction == "pop" &&
+    if (line.getInstruction() == "pop" &&
         (line.getArg0().getType() == Operand::OperandType::SYMB_VAL ||
          line.getArg0().getType() == Operand::OperandType::ABS_VAL))
     {
@@ -616,14 +955,18 @@ bool Assembler::unaryInstructionHandler(Assembler &assembler, const Line &line,
         return false;
     }
     int len = 2;
-    if (line.getArg0().getType() != Operand::REGISTER)
+    if (assembler.needsWord(line.getArg0()))
     {
         len += 2;
     }
+    else if (!firstPass && line.getArg0().getType() != Operand::REGISTER)
+    {
+        assembler.shortened++;
+    }
     if (!firstPass)
     {
         assembler.code[assembler.locationCounter] =
-                opcodes[line.getInstruction()] << 2;
+                opcodeOf(line.getInstruction()) << 2;
         if (!assembler.emmitArguments(line, assembler.locationCounter))
             return false;
     }
@@ -644,13 +987,69 @@ bool Assembler::noargInstructionHandler(Assembler &assembler, const Line &line,
     if (!firstPass)
     {
         assembler.code[assembler.locationCounter] =
-                opcodes[line.getInstruction()] << 2;
+                opcodeOf(line.getInstruction()) << 2;
         assembler.code[assembler.locationCounter + 1] = 0xe7;
     }
     assembler.locationCounter += 2;
     return true;
 }
 
+// Register-direct first operand picks the block operation, the second is psw
+// as in iret
+bool Assembler::blockInstructionHandler(Assembler &assembler, const Line &line,
+                                        bool firstPass)
+{
+    if (line.getArg0().getType() != Operand::NONE)
+    {
+        assembler.emmitError(
+                "Instruction " + line.getInstruction() + " has no arguments",
+                line.getNumber());
+        return false;
+    }
+    if (!firstPass)
+    {
+        uint8_t operation = line.getInstruction() == "blkmov" ? BLOCK_MOVE : BLOCK_FILL;
+        assembler.code[assembler.locationCounter] = (BLOCK_OPCODE << 2) | 1;
+        assembler.code[assembler.locationCounter + 1] = (operation << 5) | 7;
+    }
+    assembler.locationCounter += 2;
+    return true;
+}
+
+// Two registers, the operation and source register go in the second word.
+// bswap alone takes one and swaps it in place.
+bool Assembler::packedInstructionHandler(Assembler &assembler, const Line &line,
+                                         bool firstPass)
+{
+    const auto &dst = line.getArg0();
+    bool unary = line.getInstruction() == "bswap" && line.getArg1().getType() == Operand::NONE;
+    const auto &src = unary ? dst : line.getArg1();
+    for (auto op:{&dst, &src})
+    {
+        if (op->getType() != Operand::REGISTER || op->getRegisterId() >= PSW_REGISTER)
+        {
+            assembler.emmitError("Instruction " + line.getInstruction() +
+                                 " works only with registers r0-r7", line.getNumber());
+            return false;
+        }
+    }
+    if (!firstPass)
+    {
+        uint8_t operation = PACKED_SWAP;
+        if (line.getInstruction() == "padd") operation = PACKED_ADD;
+        else if (line.getInstruction() == "psub") operation = PACKED_SUB;
+        else if (line.getInstruction() == "pcmpeq") operation = PACKED_CMPEQ;
+        else if (line.getInstruction() == "pmin") operation = PACKED_MIN;
+        else if (line.getInstruction() == "pmax") operation = PACKED_MAX;
+        assembler.code[assembler.locationCounter] = (BLOCK_OPCODE << 2) | 1;
+        assembler.code[assembler.locationCounter + 1] = dst.getRegisterId() << 5;
+        assembler.emmitValue((operation << PACKED_OPERATION_SHIFT) | src.getRegisterId(),
+                             assembler.locationCounter + 2, 2);
+    }
+    assembler.locationCounter += 4;
+    return true;
+}
+
 bool Assembler::emmitArguments(const Operand &arg0, const Operand &arg1,
                                uint16_t location)
 {
@@ -671,6 +1070,7 @@ bool Assembler::emmitArguments(const Operand &arg0, const Operand &arg1,
         case Operand::OperandType::ABS_VAL:
         case Operand::OperandType::MEMDIR:
         case Operand::OperandType::REGISTER_OFFS_ABS:
+            if (immediateField(arg0) != 0) break;
             if(arg0.getNumericValue()>INT16_MAX || arg0.getNumericValue()<INT16_MIN) emmitWarning("The value may be truncated");
             emmitValue(arg0.getNumericValue(), location + 2, 2);
             break;
@@ -695,6 +1095,7 @@ bool Assembler::emmitArguments(const Operand &arg0, const Operand &arg1,
         case Operand::OperandType::ABS_VAL:
         case Operand::OperandType::MEMDIR:
         case Operand::OperandType::REGISTER_OFFS_ABS:
+            if (immediateField(arg1) != 0) break;
             if(arg1.getNumericValue()>INT16_MAX || arg1.getNumericValue()<INT16_MIN) emmitWarning("The value may be truncated");
             emmitValue(arg1.getNumericValue(), location + 2, 2);
             break;
@@ -731,8 +1132,9 @@ bool Assembler::retInstructionHandler(Assembler &assembler, const Line &line,
                 line.getNumber());
         return false;
     }
-    return unaryInstructionHandler(assembler, Line("pop pc", line.getNumber()),
-                                    firstPass);
+    Operand pc(Operand::REGISTER, 0, PC_REGISTER, StringRef());
+    return unaryInstructionHandler(assembler, Line(line, "pop", pc, Operand()),
+                                   firstPass);
 }
 
 bool Assembler::jmpInstructionHandler(Assembler &assembler, const Line &line,
@@ -753,9 +1155,27 @@ bool Assembler::jmpInstructionHandler(Assembler &assembler, const Line &line,
     }
     if (line.getArg0().getType() == Operand::OperandType::PCREL)
     {
+        auto shortJump = assembler.shortJumps.find(assembler.currentLine);
+        if (firstPass)
+        {
+            assembler.jumpSites.push_back({line.getArg0().getSymbol(), (uint16_t)assembler.locationCounter,
+                                           assembler.currentSection, assembler.currentLine});
+        }
+        if (shortJump != assembler.shortJumps.end())
+        {
+            if (!firstPass)
+            {
+                assembler.code[assembler.locationCounter] = ADD_OPCODE << 2;
+                assembler.code[assembler.locationCounter] |= 1;
+                assembler.code[assembler.locationCounter + 1] = 0xe0 | shortJump->second;
+                assembler.shortened++;
+            }
+            assembler.locationCounter += 2;
+            return true;
+        }
         if (!firstPass)
         {
-            assembler.code[assembler.locationCounter] = opcodes["add"] << 2;
+            assembler.code[assembler.locationCounter] = ADD_OPCODE << 2;
             assembler.code[assembler.locationCounter] |= 1;
             assembler.code[assembler.locationCounter + 1] = 0xe0;
             if (!assembler.putSymbol(line.getArg0().getSymbol(), true,
@@ -772,37 +1192,41 @@ bool Assembler::jmpInstructionHandler(Assembler &assembler, const Line &line,
         auto arg=line.getArg0();
         if(arg.getType()==Operand::OperandType::MEMDIR)
         {
-            arg=Operand(std::to_string(arg.getNumericValue()));
+            arg=Operand(Operand::ABS_VAL, arg.getNumericValue(), 0, StringRef());
         }
         else if(arg.getType()==Operand::OperandType::SYMB)
         {
-            arg=Operand("&"+arg.getSymbol());
+            arg=Operand(Operand::SYMB_VAL, 0, 0, arg.getSymbol());
         }
         else if(arg.getType()!=Operand::OperandType::SYMB_VAL)
         {
             assembler.emmitError("Unsupported operand type for JMP");
             return false;
         }
-        return binaryInstructionHandler(assembler, Line("mov pc, " +
-                                                        arg.getValue(),
-                                                        line.getNumber()),
+        Operand pc(Operand::REGISTER, 0, PC_REGISTER, StringRef());
+        return binaryInstructionHandler(assembler, Line(line, "mov", pc, arg),
                                         firstPass);
     }
 }
 
-bool Assembler::putSymbol(std::string symbol, bool relative, uint16_t location,
+bool Assembler::putSymbol(const StringRef &symbol, bool relative, uint16_t location,
                           uint16_t length)
 {
-    auto &symb = symbolTable[symbol];
+    if (onePass)
+    {
+        fixups.push_back({symbol, relative, location, length, currentSection, currentLine});
+        return true;
+    }
+    auto &symb = symbolTable[symbol.str()];
+    uint32_t targetSymbol = symb.getNameId();
     uint32_t insertedValue;
-    std::string relType = "";
-    std::string targetSymbol = symbol;
+    RelocationEntry::Type relType;
     if (symb.isGlobal())
     {
         if (relative)
         {
-            relType = "REL" + std::to_string(length);
-            if(symb.getSection()==currentSection)
+            relType = RelocationEntry::REL;
+            if(symb.getSectionId()==currentSection)
             {
                 insertedValue = symb.getOffset() - location - 2;
             }
@@ -813,28 +1237,37 @@ bool Assembler::putSymbol(std::string symbol, bool relative, uint16_t location,
         }
         else
         {
-            relType = "ABS" + std::to_string(length);
+            relType = RelocationEntry::ABS;
             insertedValue = 0;
         }
     }
     else
     {
-        targetSymbol = symb.getSection();
+        targetSymbol = symb.getSectionId();
         if (relative)
         {
-            relType = "REL" + std::to_string(length);
+            relType = RelocationEntry::REL;
             insertedValue = symb.getOffset() - location - 2;
         }
         else
         {
             insertedValue = symb.getOffset();
-            relType = "ABS" + std::to_string(length);
+            relType = RelocationEntry::ABS;
         }
     }
-    if (!(relative && symb.getSection() == currentSection))
+    bool crossFragment = fragments && relative &&
+                         symb.getSectionId() == currentSection &&
+                         fragmentAt(currentSection, symb.getOffset()) !=
+                         fragmentAt(currentSection, location);
+    if (crossFragment && symb.isGlobal())
+    {
+        insertedValue = -2;
+    }
+    if (!(relative && symb.getSectionId() == currentSection) || crossFragment)
     {
         relocations.push_back(
-                RelocationEntry(location, targetSymbol, relType, currentSection));
+                RelocationEntry(location, targetSymbol, relType, length,
+                                currentSection));
     }
     emmitValue(insertedValue, location, length);
     return true;
@@ -854,47 +1287,112 @@ bool Assembler::emmitValue(uint32_t value, uint16_t location, uint16_t length)
     return true;
 }
 
+std::map<uint16_t, uint32_t> Assembler::sectionStarts()
+{
+    std::map<uint16_t, uint32_t> starts;
+    for (auto &iter: symbolTable)
+    {
+        if (iter.second.getType() == Symbol::Type::SECTION)
+        {
+            starts.insert({(uint16_t) iter.second.getOffset(), iter.second.getSectionId()});
+        }
+    }
+    return starts;
+}
+
 void Assembler::outputCode(std::ostream &stream, bool binary)
 {
-    stream << "CODE:";
-    std::string csec;
-    auto flags = stream.flags();
-    stream << std::hex;
-    stream << std::setw(2);
-    stream << std::setfill('0');
+    static const char hexDigits[] = "0123456789abcdef";
+    auto starts = sectionStarts();
+    auto next = starts.begin();
+    std::string buffer = "CODE:";
+    buffer.reserve(buffer.size() + (locationCounter - startAddress) * (binary ? 10 : 3) + starts.size() * 16);
+    uint32_t csec = StringTable::UNKNOWN;
     int oc = 0;
-    for (uint16_t i = startAddress; i < locationCounter; i++, oc++)
+    for (uint32_t i = startAddress; i < locationCounter; i++, oc++)
     {
-        auto sec = sectionAt(i);
-        if (!sec.empty())
+        while (next != starts.end() && next->first < i) next++;
+        if (next != starts.end() && next->first == i)
         {
-            csec = sec;
-            if (csec != ".bss") stream << "\n" + csec + "\n";
+            csec = next->second;
+            if (csec != StringTable::BSS) buffer += "\n" + StringTable::lookup(csec) + "\n";
             oc = 0;
         }
-        if (csec == ".bss") continue;
+        if (csec == StringTable::BSS) continue;
+        uint8_t value = code[i];
         if (!binary)
         {
-            if (oc != 0 && oc % 16 == 0) stream << "\n";
-            int value = (int) (code[i]);
-            if (value == 0)
-            {
-                stream << "00 ";
-            }
-            else
+            if (oc != 0 && oc % 16 == 0) buffer += '\n';
+            buffer += hexDigits[value >> 4u];
+            buffer += hexDigits[value & 15u];
+            buffer += ' ';
+        }
+        else
+        {
+            if (i != 0 && i % 4 == 0) buffer += '\n';
+            for (int bit = 7; bit >= 0; bit--)
             {
-                stream << std::hex;
-                stream << std::setw(2);
-                stream << (int) (code[i]) << ' ';
+                buffer += (value >> bit) & 1u ? '1' : '0';
             }
+            buffer += ' ';
         }
-        else
+    }
+    stream.write(buffer.data(), buffer.size());
+}
+
+void Assembler::outputObject(std::ostream &stream, bool raw)
+{
+    stream << "START: " << startAddress << "\n";
+    outputSymbolTable(stream);
+    outputRelocationTable(stream);
+    if (fragments) outputFragmentTable(stream);
+    if (lineTable) outputLineTable(stream);
+    if (raw) outputRawCode(stream);
+    else outputCode(stream, false);
+}
+
+void Assembler::outputRawCode(std::ostream &stream)
+{
+    std::vector<std::pair<uint16_t, std::string> > sections;
+    for (auto &iter: symbolTable)
+    {
+        if (iter.second.getType() == Symbol::Type::SECTION && iter.second.getSectionId() != StringTable::BSS)
         {
-            if (i != 0 && i % 4 == 0) stream << "\n";
-            stream << binstr(code[i]) << " ";
+            sections.push_back({(uint16_t) iter.second.getOffset(), iter.second.getName()});
         }
     }
-    stream.flags(flags);
+    std::sort(sections.begin(), sections.end());
+    std::string buffer = "CODE: RAW\n";
+    for (auto &section:sections)
+    {
+        auto &symbol = symbolTable[section.second];
+        buffer += section.second + " " + std::to_string(symbol.getLength()) + "\n";
+        buffer.append((const char *) code + symbol.getOffset(), symbol.getLength());
+    }
+    stream.write(buffer.data(), buffer.size());
+}
+
+uint8_t Assembler::shortImmediate(int32_t value)
+{
+    static const int16_t shortImmediates[SHORT_IMMEDIATE_COUNT] = SHORT_IMMEDIATES;
+    for (uint8_t field = 1; field < SHORT_IMMEDIATE_COUNT; field++)
+    {
+        if (shortImmediates[field] == value) return field;
+    }
+    return 0;
+}
+
+// Operand field of an absolute value, 0 unless it has a short form
+uint8_t Assembler::immediateField(const Operand &op) const
+{
+    if (!shortEncodings || op.getType() != Operand::ABS_VAL) return 0;
+    return shortImmediate(op.getNumericValue());
+}
+
+bool Assembler::needsWord(const Operand &op) const
+{
+    if (op.getType() == Operand::NONE || op.getType() == Operand::REGISTER) return false;
+    return immediateField(op) == 0;
 }
 
 bool Assembler::getOperand(const Operand &op, uint8_t &operand)
@@ -932,6 +1430,8 @@ bool Assembler::getOperand(const Operand &op, uint8_t &operand)
             break;
         }
         case Operand::OperandType::ABS_VAL:
+            operand = immediateField(op);
+            break;
         case Operand::OperandType::SYMB_VAL:
             operand = 0;
             break;
@@ -946,20 +1446,10 @@ bool Assembler::getOperand(const Operand &op, uint8_t &operand)
     return true;
 }
 
-std::unordered_map<std::string, std::function<bool(Assembler &, const Line &,
-                                                   bool)> >
-        Assembler::dotHandlers = {{".char",    Assembler::dotCharHandler},
-                                  {".word",    Assembler::dotWordHandler},
-                                  {".long",    Assembler::dotLongHandler},
-                                  {".align",   Assembler::dotAlignHandler},
-                                  {".skip",    Assembler::dotSkipHandler},
-                                  {".global",  Assembler::dotGlobalHandler},
-                                  {".section", Assembler::dotSectionHandler}};
-
-std::set<std::string> Assembler::allowedSections = {".text", ".data", ".rodata",
+const std::set<std::string> Assembler::allowedSections = {".text", ".data", ".rodata",
                                                     ".bss"};
 
-std::set<std::string> Assembler::reservedSymbols = {"PC", "PSW", "SP",
+const std::set<std::string> Assembler::reservedSymbols = {"PC", "PSW", "SP",
                                                     "pc", "psw", "sp",
                                                     "r0", "r1", "r2",
                                                     "r3", "r4", "r5",
@@ -968,82 +1458,219 @@ std::set<std::string> Assembler::reservedSymbols = {"PC", "PSW", "SP",
                                                     "R3", "R4", "R5",
                                                     "R6", "R7"};
 
-std::unordered_map<std::string, std::function<bool(Assembler &, const Line &,
-                                                   bool)> >
-        Assembler::instructionHandlers = {{"add",  Assembler::binaryInstructionHandler},
-                                          {"sub",  Assembler::binaryInstructionHandler},
-                                          {"mul",  Assembler::binaryInstructionHandler},
-                                          {"div",  Assembler::binaryInstructionHandler},
-                                          {"cmp",  Assembler::binaryInstructionHandler},
-                                          {"and",  Assembler::binaryInstructionHandler},
-                                          {"or",   Assembler::binaryInstructionHandler},
-                                          {"not",  Assembler::binaryInstructionHandler},
-                                          {"test", Assembler::binaryInstructionHandler},
-                                          {"mov",  Assembler::binaryInstructionHandler},
-                                          {"shl",  Assembler::binaryInstructionHandler},
-                                          {"shr",  Assembler::binaryInstructionHandler},
-                                          {"push", Assembler::unaryInstructionHandler},
-                                          {"pop",  Assembler::unaryInstructionHandler},
-                                          {"call", Assembler::unaryInstructionHandler},
-                                          {"iret", Assembler::noargInstructionHandler},
-                                          {"ret",  Assembler::retInstructionHandler},
-                                          {"jmp",  Assembler::jmpInstructionHandler}};
-
-std::unordered_map<std::string, uint8_t> Assembler::opcodes = {{"add",  0},
-                                                               {"sub",  1},
-                                                               {"mul",  2},
-                                                               {"div",  3},
-                                                               {"cmp",  4},
-                                                               {"and",  5},
-                                                               {"or",   6},
-                                                               {"not",  7},
-                                                               {"test", 8},
-                                                               {"push", 9},
-                                                               {"pop",  10},
-                                                               {"call", 11},
-                                                               {"iret", 12},
-                                                               {"mov",  13},
-                                                               {"shl",  14},
-                                                               {"shr",  15}};
-
-std::string Assembler::sectionAt(uint16_t location)
-{
-    for (auto iter: symbolTable)
-    {
-        if (iter.second.getOffset() == location &&
-            iter.second.getType() == Symbol::Type::SECTION)
+// Indexed by findMnemonic; ret and jmp have no opcode of their own and are
+// encoded as pop and add/mov by their handlers, the block and packed
+// instructions share iret's
+const Assembler::Mnemonic Assembler::mnemonics[] = {{"add",  binaryInstructionHandler,  0},
+                                                    {"sub",  binaryInstructionHandler,  1},
+                                                    {"mul",  binaryInstructionHandler,  2},
+                                                    {"div",  binaryInstructionHandler,  3},
+                                                    {"cmp",  binaryInstructionHandler,  4},
+                                                    {"and",  binaryInstructionHandler,  5},
+                                                    {"or",   binaryInstructionHandler,  6},
+                                                    {"not",  binaryInstructionHandler,  7},
+                                                    {"test", binaryInstructionHandler,  8},
+                                                    {"push", unaryInstructionHandler,   9},
+                                                    {"call", unaryInstructionHandler,   11},
+                                                    {"mov",  binaryInstructionHandler,  13},
+                                                    {"shl",  binaryInstructionHandler,  14},
+                                                    {"shr",  binaryInstructionHandler,  15},
+                                                    {"iret", noargInstructionHandler,   12},
+                                                    {"pop",  unaryInstructionHandler,   10},
+                                                    {"ret",  retInstructionHandler,     10},
+                                                    {"jmp",  jmpInstructionHandler,     13},
+                                                    {"blkmov", blockInstructionHandler, 12},
+                                                    {"blkset", blockInstructionHandler, 12},
+                                                    {"padd", packedInstructionHandler,  12},
+                                                    {"psub", packedInstructionHandler,  12},
+                                                    {"pcmpeq", packedInstructionHandler, 12},
+                                                    {"pmin", packedInstructionHandler,  12},
+                                                    {"pmax", packedInstructionHandler,  12},
+                                                    {"bswap", packedInstructionHandler, 12}};
+
+void Assembler::outputRelocationTable(std::ostream &stream)
+{
+    std::string buffer = "RELTAB:\n";
+    buffer += "Name            Section         Offset          TYPE      \n";
+    for (auto &rel:relocations)
+    {
+        if(rel.getSectionId()==StringTable::BSS) continue;
+        appendField(buffer, rel.getTargetSymbol(), 16);
+        appendField(buffer, rel.getSection(), 16);
+        appendField(buffer, std::to_string(rel.getOffset()), 16);
+        appendField(buffer, rel.getTypeName(), 10);
+        buffer += '\n';
+    }
+    stream.write(buffer.data(), buffer.size());
+}
+
+void Assembler::computeFragments()
+{
+    fragmentRanges.clear();
+    std::map<uint32_t, std::set<uint16_t> > starts;
+    for (auto &symb:symbolTable)
+    {
+        auto &symbol = symb.second;
+        if (symbol.getType() == Symbol::SECTION)
+        {
+            uint16_t end = symbol.getSectionId() == currentSection ?
+                           locationCounter : symbol.getOffset() + symbol.getLength();
+            starts[symbol.getSectionId()].insert(symbol.getOffset());
+            starts[symbol.getSectionId()].insert(end);
+        }
+        else if (symbol.getSectionId() == StringTable::TEXT &&
+                 declaredGlobals.count(symbol.getName()) != 0)
+        {
+            starts[StringTable::TEXT].insert(symbol.getOffset());
+        }
+    }
+    for (auto &section:starts)
+    {
+        auto &ranges = fragmentRanges[section.first];
+        for (auto iter = section.second.begin();
+             std::next(iter) != section.second.end(); iter++)
+        {
+            ranges.push_back({*iter, *std::next(iter)});
+        }
+    }
+}
+
+int Assembler::fragmentAt(uint32_t section, uint16_t location)
+{
+    auto &ranges = fragmentRanges[section];
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        if (location >= ranges[i].first && location < ranges[i].second)
         {
-            return iter.second.getName();
+            return (int) i;
         }
     }
-    return "";
+    return ranges.empty() ? -1 : (int) ranges.size() - 1;
 }
 
-void Assembler::outputRelocationTable(std::ostream &stream)
+void Assembler::outputFragmentTable(std::ostream &stream)
 {
-    stream << "RELTAB:\n";
+    stream << "FRAGMENTS:\n";
     stream
-            << "Name            Section         Offset          TYPE      \n";
-    std::vector<std::string> symbols(symbolTable.size());
-    for (auto symb:symbolTable)
+            << "Section         Start           Length          Flow\n";
+    std::vector<std::pair<uint16_t, uint32_t> > sections;
+    for (auto &section:fragmentRanges)
     {
-        symbols[symb.second.getSeq()] = symb.second.getName();
+        if (section.second.empty()) continue;
+        sections.push_back({section.second.front().first, section.first});
     }
+    std::sort(sections.begin(), sections.end());
     auto flags = stream.flags();
-    for (auto &rel:relocations)
+    for (auto &section:sections)
     {
-        if(rel.getSection()==".bss") continue;
-        stream << std::setw(16) << std::left;
-        stream << rel.getTargetSymbol();
-        stream << std::setw(16) << std::left;
-        stream << rel.getSection();
-        stream << std::setw(16) << std::left;
-        stream << rel.getOffset();
-        stream << std::setw(10) << std::left;
-        stream << rel.getType();
-        stream << "\n";
+        for (auto &range:fragmentRanges[section.second])
+        {
+            stream << std::setw(16) << std::left;
+            stream << StringTable::lookup(section.second);
+            stream << std::setw(16) << std::left;
+            stream << range.first;
+            stream << std::setw(16) << std::left;
+            stream << range.second - range.first;
+            if (section.second == StringTable::TEXT &&
+                transferEnds.count(range.second) == 0)
+            {
+                stream << "FALLTHROUGH";
+            }
+            else
+            {
+                stream << "END";
+            }
+            stream << "\n";
+        }
     }
     stream.flags(flags);
 }
 
+// One row per section: the first instruction's address and line, then an
+// address,line delta pair for every following instruction
+void Assembler::outputLineTable(std::ostream &stream)
+{
+    std::map<std::string, std::vector<SourceLine> > sections;
+    for (auto &sourceLine:sourceLines)
+    {
+        sections[StringTable::lookup(sourceLine.section)].push_back(sourceLine);
+    }
+    std::string buffer = "LINES: " + file.getName() + "\n";
+    buffer += "Section         Start           Line            Deltas\n";
+    for (auto &section:sections)
+    {
+        auto &entries = section.second;
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const SourceLine &l1, const SourceLine &l2) { return l1.location < l2.location; });
+        appendField(buffer, section.first, 16);
+        appendField(buffer, std::to_string(entries.front().location), 16);
+        appendField(buffer, std::to_string(entries.front().line), 16);
+        for (size_t i = 1; i < entries.size(); i++)
+        {
+            buffer += std::to_string(entries[i].location - entries[i - 1].location) + ",";
+            buffer += std::to_string((int64_t) entries[i].line - entries[i - 1].line) + " ";
+        }
+        buffer += '\n';
+    }
+    stream.write(buffer.data(), buffer.size());
+}
 
+void Assembler::outputListing(std::ostream &stream)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string buffer = "LISTING: " + file.getName() + "\n";
+    buffer += "Line    Address Bytes                   Length  Words  Reads  Writes Extra  Cost   Source\n";
+    unsigned blockCost = 0;
+    uint32_t blockSection = StringTable::UNKNOWN;
+    auto endBlock = [&buffer, &blockCost]()
+    {
+        if (blockCost == 0) return;
+        appendField(buffer, "", 48);
+        buffer += "Block cost " + std::to_string(blockCost) + "\n";
+        blockCost = 0;
+    };
+    for (auto &entry:listingLines)
+    {
+        auto &line = *entry.line;
+        if (!line.getLabel().empty() || entry.section != blockSection) endBlock();
+        blockSection = entry.section;
+        appendField(buffer, std::to_string(line.getNumber()), 8);
+        bool hasBytes = entry.length > 0 && entry.section != StringTable::BSS;
+        appendField(buffer, hasBytes ? std::to_string(entry.location) : "", 8);
+        std::string bytes;
+        for (uint16_t i = 0; hasBytes && i < entry.length; i++)
+        {
+            if (i == 8)
+            {
+                bytes += "...";
+                break;
+            }
+            bytes += hexDigits[code[entry.location + i] >> 4u];
+            bytes += hexDigits[code[entry.location + i] & 15u];
+            bytes += ' ';
+        }
+        appendField(buffer, bytes, 24);
+        appendField(buffer, entry.length > 0 ? std::to_string(entry.length) : "", 8);
+        bool transfer = false;
+        if (line.getType() == Line::INSTRUCTION && hasBytes)
+        {
+            auto cost = estimateCost(Instruction((uint16_t) (code[entry.location] | code[entry.location + 1] << 8u)));
+            appendField(buffer, std::to_string(cost.words), 7);
+            appendField(buffer, std::to_string(cost.reads), 7);
+            appendField(buffer, std::to_string(cost.writes), 7);
+            appendField(buffer, std::to_string(cost.extra), 7);
+            appendField(buffer, std::to_string(cost.total()), 7);
+            blockCost += cost.total();
+            transfer = cost.transfer;
+        }
+        else
+        {
+            appendField(buffer, "", 35);
+        }
+        buffer.append(line.getLine().data(), line.getLine().length());
+        buffer += '\n';
+        if (transfer) endBlock();
+    }
+    endBlock();
+    stream.write(buffer.data(), buffer.size());
+}
@@ -9,58 +9,162 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
-#include <functional>
 #include <set>
+#include <map>
 #include "../common/Symbol.h"
 #include "File.h"
 #include "../common/RelocationEntry.h"
 #include "../common/machine_params.h"
 
+#define NO_CONDITION 4
+#define MAX_MNEMONIC_LENGTH 8
+#define ADD_OPCODE 0
+#define POP_OPCODE 10
+#define MOV_OPCODE 13
+#define MAX_SHRINK_ITERATIONS 16
+// Bump whenever the same source and options assemble to a different object
+#define ASSEMBLER_VERSION 1
+
 class Assembler
 {
 public:
     explicit Assembler(const File &file, uint16_t startAddress);
+    ~Assembler();
+    Assembler(const Assembler&)=delete;
+    Assembler &operator=(const Assembler&)=delete;
     bool firstPass();
     bool secondPass();
+    // Declares labels and encodes in one scan, references to later labels are patched at the end
+    bool singlePass();
+    void setFragments(bool fragments);
+    // Use the short immediate forms, needs an emulator that knows them
+    void setShortEncodings(bool shortEncodings);
+    // Assemble these lines instead of the file's, they must outlive the assembler
+    void setLines(const std::vector<Line> &lines);
+    // Emit a table of instruction addresses and their source lines
+    void setLineTable(bool lineTable);
+    // Remember where every line went, for outputListing
+    void setListing(bool listing);
 
     void outputSymbolTable(std::ostream &stream);
     void outputRelocationTable(std::ostream &stream);
+    void outputFragmentTable(std::ostream &stream);
+    void outputLineTable(std::ostream &stream);
+    // Source lines with their address, bytes and estimated cost, and the cost of every basic block
+    void outputListing(std::ostream &stream);
     void outputCode(std::ostream &stream, bool binary=false);
+    void outputRawCode(std::ostream &stream);
+    // Whole object file: start address, tables and code
+    void outputObject(std::ostream &stream, bool raw=false);
 
     const std::vector<std::string> &getErrors() const;
     const std::vector<std::string> &getWarnings() const;
+    uint getShortenedInstructions() const;
+
+    // Lowercase mnemonic without its condition suffix, or nullptr if unknown
+    static const char *decodeInstruction(const StringRef &token, uint8_t &condition);
 
 protected:
+    struct Fixup
+    {
+        StringRef symbol;
+        bool relative;
+        uint16_t location;
+        uint16_t length;
+        uint32_t section;
+        uint line;
+    };
+    struct SourceLine
+    {
+        uint32_t section;
+        uint16_t location;
+        uint line;
+    };
+    struct ListingLine
+    {
+        const Line *line;
+        uint16_t location;
+        uint16_t length;
+        uint32_t section;
+    };
+    struct JumpSite
+    {
+        StringRef symbol;
+        uint16_t location;
+        uint32_t section;
+        uint line;
+    };
+
+    bool scanLines(bool firstPass);
+    void recordListing(const Line &line, uint32_t location);
+    bool scanFirst();
+    bool relaxJumps(bool &resized, bool shrink);
+    bool needsWord(const Operand &op) const;
+    uint8_t immediateField(const Operand &op) const;
+    static uint8_t shortImmediate(int32_t value);
+    bool resolveFixups();
     bool declareSymbol(std::string name, bool firstPass, bool global);
     bool declareSection(std::string name, bool firstPass);
     bool handleDot(const Line &line, bool firstPass);
     bool handleInstruction(const Line &line, bool firstPass);
     bool emmitArguments(const Line &line, uint16_t location);
     bool emmitArguments(const Operand &arg0, const Operand& arg1, uint16_t location);
-    bool putSymbol(std::string symbol, bool relative, uint16_t location, uint16_t length);
+    bool putSymbol(const StringRef &symbol, bool relative, uint16_t location, uint16_t length);
     bool emmitValue(uint32_t value, uint16_t location, uint16_t length);
     void emmitError(const std::string &message, int line=-1);
     void emmitWarning(const std::string &message, int line=-1);
     bool getOperand(const Operand &op, uint8_t& operand);
-    std::string sectionAt(uint16_t location);
+    std::map<uint16_t, uint32_t> sectionStarts();
+    void computeFragments();
+    int fragmentAt(uint32_t section, uint16_t location);
     uint8_t *code;
     uint8_t *baseCode;
     uint currentLine;
     const File &file;
+    const std::vector<Line> *lines;
     const uint16_t startAddress;
     bool running;
-    std::string currentSection;
+    // StringTable id, UNKNOWN outside of any section
+    uint32_t currentSection;
     uint32_t locationCounter;
     std::unordered_map<std::string, Symbol> symbolTable;
     std::vector<std::string> errors;
     std::vector<std::string> warnings;
     std::vector<RelocationEntry> relocations;
+    bool fragments;
+    std::set<std::string> declaredGlobals;
+    std::map<uint32_t, std::vector<std::pair<uint16_t, uint16_t> > > fragmentRanges;
+    std::set<uint16_t> transferEnds;
+    bool onePass;
+    std::vector<Fixup> fixups;
+    std::vector<std::string> globalNames;
+    bool shortEncodings;
+    std::vector<JumpSite> jumpSites;
+    std::unordered_map<uint, uint8_t> shortJumps;
+    uint shortened;
+    bool lineTable;
+    std::vector<SourceLine> sourceLines;
+    bool listing;
+    std::vector<ListingLine> listingLines;
+
+    typedef bool (*DotHandler)(Assembler&, const Line&, bool);
+    typedef bool (*InstructionHandler)(Assembler&, const Line&, bool);
+    struct Mnemonic
+    {
+        const char *name;
+        InstructionHandler handler;
+        uint8_t opcode;
+    };
 
-    static std::unordered_map<std::string, std::function<bool(Assembler&, const Line&, bool)> > dotHandlers;
-    static std::unordered_map<std::string, uint8_t > opcodes;
-    static std::set<std::string> allowedSections;
-    static std::set<std::string> reservedSymbols;
-    static std::unordered_map<std::string, std::function<bool(Assembler&, const Line&, bool)> > instructionHandlers;
+    static const Mnemonic mnemonics[];
+    static const Mnemonic *findMnemonic(const char *token, size_t length);
+    static const Mnemonic *decodeMnemonic(const StringRef &token, uint8_t &condition);
+    static uint8_t conditionCode(char first, char second);
+    static uint8_t opcodeOf(const StringRef &instruction);
+    static DotHandler findDirective(const StringRef &directive);
+    static const std::set<std::string> allowedSections;
+    static const std::set<std::string> reservedSymbols;
+    static bool dotEndHandler(Assembler &assembler, const Line &line, bool firstPass);
     static bool dotCharHandler(Assembler &assembler, const Line &line, bool firstPass);
     static bool dotWordHandler(Assembler &assembler, const Line &line, bool firstPass);
     static bool dotLongHandler(Assembler &assembler, const Line &line, bool firstPass);
@@ -74,6 +178,8 @@ protected:
     static bool noargInstructionHandler(Assembler &assembler, const Line &line, bool firstPass);
     static bool retInstructionHandler(Assembler &assembler, const Line &line, bool firstPass);
     static bool jmpInstructionHandler(Assembler &assembler, const Line &line, bool firstPass);
+    static bool blockInstructionHandler(Assembler &assembler, const Line &line, bool firstPass);
+    static bool packedInstructionHandler(Assembler &assembler, const Line &line, bool firstPass);
 
     static bool getInt(std::string strInt, int &value);
 };
@@ -2,9 +2,19 @@
 // Created by nidzo on 20.5.18..
 //
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "File.h"
 
-File::File(std::ifstream &inputStream, std::string fileName)
+#define READ_CHUNK_SIZE 65536
+
+File::File(std::istream &inputStream, std::string fileName)
+:name(fileName), mapped(nullptr), mappedSize(0)
 {
     if(inputStream.fail())
     {
@@ -13,20 +23,108 @@ File::File(std::ifstream &inputStream, std::string fileName)
         return;
     }
     valid=true;
+    char chunk[READ_CHUNK_SIZE];
+    while(inputStream.read(chunk, READ_CHUNK_SIZE) || inputStream.gcount()>0)
+    {
+        source.append(chunk, (size_t)inputStream.gcount());
+    }
+    parse(source.data(), source.size());
+}
+
+File::File(const std::string &fileName)
+:valid(true), name(fileName), mapped(nullptr), mappedSize(0)
+{
+    if(fileName=="-")
+    {
+        if(!readDescriptor(STDIN_FILENO))
+        {
+            valid=false;
+            errors.push_back("Failed to read standard input");
+            return;
+        }
+        parse(source.data(), source.size());
+        return;
+    }
+    int fd=open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd<0 || fstat(fd, &st)!=0)
+    {
+        if(fd>=0) close(fd);
+        valid=false;
+        errors.push_back("Failed to open file "+fileName);
+        return;
+    }
+    if(S_ISREG(st.st_mode) && st.st_size>0)
+    {
+        auto size=(size_t)st.st_size;
+        void *buffer=mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(buffer!=MAP_FAILED)
+        {
+            close(fd);
+            mapped=buffer;
+            mappedSize=size;
+            madvise(mapped, mappedSize, MADV_SEQUENTIAL);
+            parse((const char*)mapped, mappedSize);
+            return;
+        }
+    }
+    bool read=readDescriptor(fd);
+    close(fd);
+    if(!read)
+    {
+        valid=false;
+        errors.push_back("Failed to read file "+fileName);
+        return;
+    }
+    parse(source.data(), source.size());
+}
+
+File::~File()
+{
+    if(mapped) munmap(mapped, mappedSize);
+}
+
+// Pipes and terminals can't be mapped, read them in large chunks instead
+bool File::readDescriptor(int fd)
+{
+    size_t size=0;
+    while(true)
+    {
+        source.resize(size+READ_CHUNK_SIZE);
+        auto count=read(fd, &source[size], READ_CHUNK_SIZE);
+        if(count<0)
+        {
+            if(errno==EINTR) continue;
+            return false;
+        }
+        if(count==0) break;
+        size+=count;
+    }
+    source.resize(size);
+    return true;
+}
+
+void File::parse(const char *data, size_t size)
+{
+    const char *end=data+size;
+    lines.reserve(std::count(data, end, '\n')+1);
     uint lineNumber=0;
-    std::string line;
-    while(!inputStream.eof())
+    const char *position=data;
+    while(true)
     {
-        std::getline(inputStream, line);
+        auto newline=(const char*)memchr(position, '\n', end-position);
+        auto lineEnd=newline ? newline : end;
+        StringRef line(position, lineEnd-position);
         lineNumber++;
-        Line l(line, lineNumber);
-        if(!Line(line, lineNumber).isValid())
+        lines.emplace_back(line, lineNumber);
+        auto &l=lines.back();
+        if(!l.isValid())
         {
             errors.push_back("Syntax error on line "+std::to_string(lineNumber)+"\n"+line);
             valid=false;
         }
-        lines.push_back(l);
-        if(l.getDirective()==".end") break;
+        if(l.getDirective()==".end" || newline==nullptr) break;
+        position=newline+1;
     }
 }
 
@@ -44,3 +142,8 @@ const std::vector<Line> &File::getLines() const
 {
     return lines;
 }
+
+const std::string &File::getName() const
+{
+    return name;
+}
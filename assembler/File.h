@@ -5,15 +5,22 @@
 #ifndef SS_FILE_H
 #define SS_FILE_H
 
-#include <fstream>
+#include <istream>
 #include <string>
 #include <vector>
 #include "Line.h"
 
+// Source file read into one buffer, or mapped when it is a regular file. Lines
+// and their operands are views into that buffer, so a File can't be copied.
 class File
 {
 public:
-    File(std::ifstream &inputStream, std::string fileName);
+    File(std::istream &inputStream, std::string fileName);
+    // "-" reads standard input
+    explicit File(const std::string &fileName);
+    ~File();
+    File(const File&)=delete;
+    File &operator=(const File&)=delete;
 
 protected:
     bool valid;
@@ -24,8 +31,15 @@ public:
 
     const std::vector<Line> &getLines() const;
 
+    const std::string &getName() const;
 
 protected:
+    void parse(const char *data, size_t size);
+    bool readDescriptor(int fd);
+    std::string name;
+    std::string source;
+    void *mapped;
+    size_t mappedSize;
     std::vector<std::string> errors;
     std::vector<Line> lines;
 };
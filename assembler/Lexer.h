@@ -0,0 +1,105 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_LEXER_H
+#define SS_LEXER_H
+
+#include <cctype>
+#include <climits>
+#include "../common/StringRef.h"
+
+// Character classes and scanners shared by Line and Operand. The skip
+// functions return the position of the first character after the token,
+// or the starting position when there is no token there.
+class Lexer
+{
+public:
+    static bool isSpace(char c)
+    {
+        return std::isspace((unsigned char)c)!=0;
+    }
+
+    static bool isDigit(char c)
+    {
+        return c>='0' && c<='9';
+    }
+
+    static bool isIdentifierStart(char c)
+    {
+        return (c>='a' && c<='z') || (c>='A' && c<='Z') || c=='_';
+    }
+
+    static bool isWordChar(char c)
+    {
+        return isIdentifierStart(c) || isDigit(c);
+    }
+
+    static bool isOperandChar(char c)
+    {
+        return isWordChar(c) || c=='-' || c=='&' || c=='*' || c=='[' || c==']' || c=='$';
+    }
+
+    static bool isDirectiveArgChar(char c)
+    {
+        return isWordChar(c) || isSpace(c) || c==',' || c=='-';
+    }
+
+    static size_t skipSpace(const StringRef &str, size_t position)
+    {
+        while(position<str.length() && isSpace(str[position])) position++;
+        return position;
+    }
+
+    static size_t skipWord(const StringRef &str, size_t position)
+    {
+        while(position<str.length() && isWordChar(str[position])) position++;
+        return position;
+    }
+
+    static size_t skipOperand(const StringRef &str, size_t position)
+    {
+        while(position<str.length() && isOperandChar(str[position])) position++;
+        return position;
+    }
+
+    static size_t skipDigits(const StringRef &str, size_t position)
+    {
+        while(position<str.length() && isDigit(str[position])) position++;
+        return position;
+    }
+
+    // Matches [A-Za-z_][A-Za-z0-9_]* exactly covering [begin, end)
+    static bool isIdentifier(const StringRef &str, size_t begin, size_t end)
+    {
+        return begin<end && isIdentifierStart(str[begin]) && skipWord(str, begin)>=end;
+    }
+
+    // Same result as atoi on [begin, end), without reading past end
+    static int toInt(const StringRef &str, size_t begin, size_t end)
+    {
+        bool negative=begin<end && str[begin]=='-';
+        if(negative) begin++;
+        long value=0;
+        for(size_t i=begin;i<end && isDigit(str[i]);i++)
+        {
+            long digit=str[i]-'0';
+            if(value>(LONG_MAX-digit)/10)
+            {
+                return (int)(negative ? LONG_MIN : LONG_MAX);
+            }
+            value=value*10+digit;
+        }
+        return (int)(negative ? -value : value);
+    }
+
+    // Matches -?[0-9]+ exactly covering [begin, end)
+    static bool isNumber(const StringRef &str, size_t begin, size_t end)
+    {
+        if(begin<end && str[begin]=='-') begin++;
+        return begin<end && skipDigits(str, begin)>=end;
+    }
+};
+
+
+#endif //SS_LEXER_H
@@ -3,82 +3,91 @@
 //
 
 #include "Line.h"
-#include <string>
-#include <regex>
-#include <iostream>
-#include <utility>
+#include "Lexer.h"
 
-std::regex COMMENT_LINE(R"(^#.*$)");
-std::regex DOTLINE(R"(^([A-Za-z_][A-Za-z0-9_]*\s*\:\s*)?(\.[A-Za-z0-9_]+)(\s*\.?[A-Za-z0-9_\s\,\-]+)?$)");
-std::regex INSLINE(R"(^([A-Za-z_][A-Za-z0-9_]*\s*\:\s*)?([A-Za-z0-9_]+)(\s*[\-A-Za-z0-9_\&\*\[\]\$]+)?(\s*\,\s*[\-A-Za-z0-9_\&\*\[\]\$]+)?$)");
-std::regex LABLINE(R"(^[A-Za-z_][A-Za-z0-9_]*\s*\:\s*$)");
-
-Line::Line(const std::string &ln, uint number)
-    :line(ln), number(number)
+Line::Line(const StringRef &ln, uint number)
+    :number(number), type(EMPTY), valid(false)
 {
-    trim(line);
-    std::smatch match;
-    valid=false;
-    if(line.length()==0 || std::regex_match(line, COMMENT_LINE))
+    size_t first=Lexer::skipSpace(ln, 0);
+    size_t last=ln.length();
+    while(last>first && Lexer::isSpace(ln[last-1])) last--;
+    line=ln.substr(first, last-first);
+    if(line.empty() || line[0]=='#')
     {
         valid=true;
-        type=EMPTY;
+        return;
+    }
+    size_t length=line.length();
+    size_t position=0;
+    if(Lexer::isIdentifierStart(line[0]))
+    {
+        size_t labelEnd=Lexer::skipWord(line, 0);
+        size_t colon=Lexer::skipSpace(line, labelEnd);
+        if(colon<length && line[colon]==':')
+        {
+            label=line.substr(0, labelEnd);
+            position=Lexer::skipSpace(line, colon+1);
+            if(position==length)
+            {
+                type=LABEL_ONLY;
+                valid=true;
+                return;
+            }
+        }
     }
-    if(std::regex_match(line, match, DOTLINE))
+    if(line[position]=='.')
     {
-        label=match[1];
-        trim(label,":");
-        directive=match[2];
-        trim(directive);
-        std::string arg=match[3];
-        trim(arg);
-        dotArg=arg;
+        size_t directiveEnd=Lexer::skipWord(line, position+1);
+        if(directiveEnd==position+1) return;
+        directive=line.substr(position, directiveEnd-position);
+        if(directiveEnd<length)
+        {
+            size_t argStart=Lexer::skipSpace(line, directiveEnd);
+            if(argStart<length && line[argStart]=='.') argStart++;
+            if(argStart==length) return;
+            for(size_t i=argStart;i<length;i++)
+            {
+                if(!Lexer::isDirectiveArgChar(line[i])) return;
+            }
+            dotArg=line.substr(Lexer::skipSpace(line, directiveEnd));
+        }
         type=DOT_DIRECTIVE;
         valid=true;
+        return;
     }
-    else if(std::regex_match(line, match, INSLINE))
+    size_t instructionEnd=Lexer::skipWord(line, position);
+    if(instructionEnd==position) return;
+    instruction=line.substr(position, instructionEnd-position);
+    position=Lexer::skipSpace(line, instructionEnd);
+    size_t operandEnd=Lexer::skipOperand(line, position);
+    if(operandEnd>position)
     {
-        type=INSTRUCTION;
-        label=match[1];
-        trim(label,":");
-        instruction=match[2];
-        trim(instruction);
-        std::transform(instruction.begin(), instruction.end(), instruction.begin(), [](char c){ return tolower(c);});
-        std::string arg=match[3];
-        trim(arg);
-        arg0=Operand(arg);
-        arg=match[4];
-        trim(arg, ",");
-        arg1=Operand(arg);
-        valid=true;
+        arg0=Operand(line.substr(position, operandEnd-position));
+        position=Lexer::skipSpace(line, operandEnd);
     }
-    else if(std::regex_match(line, match, LABLINE))
+    if(position<length)
     {
-        type=LABEL_ONLY;
-        label=line;
-        trim(label,":");
-        valid=true;
+        if(line[position]!=',') return;
+        position=Lexer::skipSpace(line, position+1);
+        operandEnd=Lexer::skipOperand(line, position);
+        if(operandEnd==position || operandEnd<length) return;
+        arg1=Operand(line.substr(position, operandEnd-position));
     }
-    valid&=(arg0.isValid() && arg1.isValid());
-}
-
-void Line::trim(std::string &line, std::string additional)
-{
-    while(line.length()>0 && (std::isspace(line[0]) || additional.find(line[0])!=std::string::npos)) line.erase(0,1);
-    while(line.length()>0 && (std::isspace(line[line.length()-1]) || additional.find(line[line.length()-1])!=std::string::npos)) line.erase(line.length()-1,1);
+    type=INSTRUCTION;
+    valid=arg0.isValid() && arg1.isValid();
 }
 
-const std::string &Line::getLine() const
+const StringRef &Line::getLine() const
 {
     return line;
 }
 
-const std::string &Line::getLabel() const
+const StringRef &Line::getLabel() const
 {
     return label;
 }
 
-const std::string &Line::getDirective() const
+const StringRef &Line::getDirective() const
 {
     return directive;
 }
@@ -93,7 +102,7 @@ const Operand &Line::getArg1() const
     return arg1;
 }
 
-const std::string &Line::getInstruction() const
+const StringRef &Line::getInstruction() const
 {
     return instruction;
 }
@@ -113,13 +122,33 @@ uint Line::getNumber() const
     return number;
 }
 
-const std::string &Line::getDotArg() const
+const StringRef &Line::getDotArg() const
 {
     return dotArg;
 }
 
-Line::Line(const Line &line, const std::string &replacedInstruction)
-:Line(line.getLine(), line.getNumber())
+Line::Line(const Line &line, const StringRef &replacedInstruction)
+:Line(line)
 {
     instruction= replacedInstruction;
 }
+
+Line::Line(const Line &line, const StringRef &replacedInstruction, const Operand &arg0, const Operand &arg1)
+:Line(line)
+{
+    instruction= replacedInstruction;
+    Line::arg0= arg0;
+    Line::arg1= arg1;
+}
+
+Line::Line(const Line &line, LineType replacedType)
+:Line(line)
+{
+    type= replacedType;
+    directive= StringRef();
+    dotArg= StringRef();
+    instruction= StringRef();
+    arg0= Operand();
+    arg1= Operand();
+    if(type==EMPTY) label= StringRef();
+}
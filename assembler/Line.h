@@ -7,45 +7,50 @@
 
 #include <string>
 #include "Operand.h"
+#include "../common/StringRef.h"
 
+// One parsed source line. All text fields are views into the source buffer
+// owned by File (or into string literals for lines built by the assembler),
+// so a Line holds no heap memory of its own. The instruction is kept as
+// written, the assembler matches it case-insensitively.
 class Line
 {
 public:
-    enum LineType{EMPTY,LABEL_ONLY, DOT_DIRECTIVE, INSTRUCTION};
+    enum LineType : uint8_t {EMPTY,LABEL_ONLY, DOT_DIRECTIVE, INSTRUCTION};
 
-    Line(const std::string &line, uint number);
-    Line(const Line& line, const std::string &replacedInstruction);
-    static void trim(std::string &line, std::string additional="");
-
-protected:
-    std::string line;
-    std::string label;
-    std::string directive;
-public:
-    uint getNumber() const;
+    Line(const StringRef &line, uint number);
+    Line(const Line& line, const StringRef &replacedInstruction);
+    Line(const Line& line, const StringRef &replacedInstruction, const Operand &arg0, const Operand &arg1);
+    // Drops the statement of a line, only its label (if any) is kept
+    Line(const Line& line, LineType replacedType);
 
 protected:
+    StringRef line;
+    StringRef label;
+    StringRef directive;
+    StringRef dotArg;
+    StringRef instruction;
     Operand arg0;
     Operand arg1;
-    std::string dotArg;
-    std::string instruction;
-    bool valid;
-    LineType type;
     uint number;
+    LineType type;
+    bool valid;
 public:
-    const std::string &getLine() const;
+    uint getNumber() const;
+
+    const StringRef &getLine() const;
 
-    const std::string &getDotArg() const;
+    const StringRef &getDotArg() const;
 
-    const std::string &getLabel() const;
+    const StringRef &getLabel() const;
 
-    const std::string &getDirective() const;
+    const StringRef &getDirective() const;
 
     const Operand &getArg0() const;
 
     const Operand &getArg1() const;
 
-    const std::string &getInstruction() const;
+    const StringRef &getInstruction() const;
 
     bool isValid() const;
 
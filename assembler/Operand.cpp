@@ -3,129 +3,96 @@
 //
 
 #include "Operand.h"
-#include "Line.h"
+#include "Lexer.h"
 #include "../common/machine_params.h"
-#include <regex>
 
-std::regex ABS_VALUE(R"(^-?[0-9]+$)");
-std::regex SYMB_VALUE(R"(^\&[A-Za-z_][A-Za-z0-9_]*$)");
-std::regex SYMBR(R"(^[A-Za-z_][A-Za-z0-9_]*$)");
-//std::regex ABS_VALUE(R"(^[0-9]+$)");
-std::regex REG_DIRECT(R"(^[Rr]([0-9]+)$)");
-std::regex NAMED_REGISTER(R"(^(?:[Pp][Cc])|(?:[Ss][Pp])|(?:[Pp][Ss][Ww])$)");
-std::regex REG_OFFSET_ABS(R"(^[Rr]([0-9]+)\[(-?[0-9]+)\]$)");
-std::regex REG_OFFSET_SYM(R"(^[Rr]([0-9]+)\[([A-Za-z_][A-Za-z0-9_]*)\]$)");
-std::regex NAMED_REG_OFFSET_ABS(R"(^((?:[Pp][Cc])|(?:[Ss][Pp]))\[(-?[0-9]+)\]$)");
-std::regex NAMED_REG_OFFSET_SYM(R"(^((?:[Pp][Cc])|(?:[Ss][Pp]))\[([A-Za-z_][A-Za-z0-9_]*)\]$)");
-std::regex PCREL_SYM(R"(^\$[A-Za-z_][A-Za-z0-9_]*$)");
-std::regex MEMDIR_VALUE(R"(^\*[0-9]+*$)");
+// Returns the register id for pc, sp or psw in any case, or -1
+static int namedRegister(const StringRef &value, size_t begin, size_t end)
+{
+    char reg[4]={0, 0, 0, 0};
+    if(end-begin>3) return -1;
+    for(size_t i=begin;i<end;i++)
+    {
+        reg[i-begin]=(char)tolower(value[i]);
+    }
+    if(strcmp(reg, "pc")==0) return PC_REGISTER;
+    if(strcmp(reg, "sp")==0) return SP_REGISTER;
+    if(strcmp(reg, "psw")==0) return PSW_REGISTER;
+    return -1;
+}
 
-Operand::Operand(std::string value)
-:value(value)
+Operand::Operand(const StringRef &value)
+:value(value), numericValue(0), registerId(0)
 {
-    std::smatch match;
     valid=true;
-    if(value.length()==0)
+    size_t length=value.length();
+    size_t bracket=0;
+    while(bracket<length && value[bracket]!='[') bracket++;
+    if(length==0)
     {
         type=NONE;
     }
-    else if(std::regex_match(value, match, MEMDIR_VALUE))
+    else if(value[0]=='*' && Lexer::skipDigits(value, 1)==length)
     {
         type=MEMDIR;
-        numericValue=(atoi(value.substr(1).c_str()));
+        numericValue=Lexer::toInt(value, 1, length);
     }
-    else if(std::regex_match(value, match, ABS_VALUE))
+    else if(Lexer::isNumber(value, 0, length))
     {
         type=ABS_VAL;
-        numericValue=atoi(value.c_str());
+        numericValue=Lexer::toInt(value, 0, length);
     }
-    else if(std::regex_match(value, match, SYMB_VALUE))
+    else if(value[0]=='&' && Lexer::isIdentifier(value, 1, length))
     {
         type=SYMB_VAL;
         symbol=value.substr(1);
     }
-    else if(std::regex_match(value, match, PCREL_SYM))
+    else if(value[0]=='$' && Lexer::isIdentifier(value, 1, length))
     {
         type=PCREL;
         symbol=value.substr(1);
         registerId=PC_REGISTER;
     }
-    else if(std::regex_match(value, match, REG_DIRECT))
+    else if((value[0]=='r' || value[0]=='R') && length>1 && Lexer::skipDigits(value, 1)==length)
     {
         type=REGISTER;
-        std::string regnum=match[1];
-        registerId=(uint)atoi(regnum.c_str());
+        registerId=(uint)Lexer::toInt(value, 1, length);
     }
-    else if(std::regex_match(value, match, NAMED_REGISTER))
+    else if(length<=3 && namedRegister(value, 0, length)>=0)
     {
         type=REGISTER;
-        std::string reg=value;
-        std::transform(reg.begin(), reg.end(), reg.begin(), [](char c){return tolower(c);});
-        if(reg=="pc")
-        {
-            registerId=PC_REGISTER;
-        }
-        else if(reg=="sp")
-        {
-            registerId=SP_REGISTER;
-        }
-        else
-        {
-            registerId=PSW_REGISTER;
-        }
+        registerId=(uint)namedRegister(value, 0, length);
     }
-    else if(std::regex_match(value, match, SYMBR))
+    else if(Lexer::isIdentifier(value, 0, length))
     {
         type=SYMB;
         symbol=value;
     }
-    else if(std::regex_match(value, match, REG_OFFSET_ABS))
+    else if(bracket<length && bracket>0 && value[length-1]==']')
     {
-        type=REGISTER_OFFS_ABS;
-        std::string regnum=match[1];
-        registerId=atoi(regnum.c_str());
-        std::string numval=match[2];
-        numericValue=atoi(numval.c_str());
-    }
-    else if(std::regex_match(value, match, NAMED_REG_OFFSET_ABS))
-    {
-        type=REGISTER_OFFS_ABS;
-        std::string reg=match[1];
-        std::transform(reg.begin(), reg.end(), reg.begin(), [](char c){return tolower(c);});
-        if(reg=="pc")
+        bool regnum=(value[0]=='r' || value[0]=='R') && bracket>1 && Lexer::skipDigits(value, 1)==bracket;
+        int named=bracket==2 ? namedRegister(value, 0, bracket) : -1;
+        if(named==PSW_REGISTER) named=-1;
+        if(!regnum && named<0)
         {
-            registerId=PC_REGISTER;
+            valid=false;
         }
-        else if(reg=="sp")
+        else if(Lexer::isNumber(value, bracket+1, length-1))
         {
-            registerId=SP_REGISTER;
+            type=REGISTER_OFFS_ABS;
+            registerId=regnum ? (uint)Lexer::toInt(value, 1, bracket) : (uint)named;
+            numericValue=Lexer::toInt(value, bracket+1, length-1);
         }
-        std::string numval=match[2];
-        numericValue=atoi(numval.c_str());
-    }
-    else if(std::regex_match(value, match, REG_OFFSET_SYM))
-    {
-        type=REGISTER_OFFS_SYM;
-        std::string regnum=match[1];
-        registerId=atoi(regnum.c_str());
-        symbol=match[2];
-        Line::trim(symbol);
-    }
-    else if(std::regex_match(value, match, NAMED_REG_OFFSET_SYM))
-    {
-        type=REGISTER_OFFS_SYM;
-        std::string reg=match[1];
-        std::transform(reg.begin(), reg.end(), reg.begin(), [](char c){return tolower(c);});
-        if(reg=="pc")
+        else if(Lexer::isIdentifier(value, bracket+1, length-1))
         {
-            registerId=PC_REGISTER;
+            type=REGISTER_OFFS_SYM;
+            registerId=regnum ? (uint)Lexer::toInt(value, 1, bracket) : (uint)named;
+            symbol=value.substr(bracket+1, length-bracket-2);
         }
-        else if(reg=="sp")
+        else
         {
-            registerId=SP_REGISTER;
+            valid=false;
         }
-        symbol=match[2];
-        Line::trim(symbol);
     }
     else
     {
@@ -133,8 +100,14 @@ Operand::Operand(std::string value)
     }
 }
 
+Operand::Operand(OperandType type, int32_t numericValue, uint registerId, const StringRef &symbol)
+:symbol(symbol), numericValue(numericValue), registerId(registerId), type(type), valid(true)
+{
+
+}
+
 Operand::Operand()
-:value(""), type(NONE), valid(true)
+:numericValue(0), registerId(0), type(NONE), valid(true)
 {
 
 }
@@ -154,7 +127,7 @@ uint Operand::getRegisterId() const
     return registerId;
 }
 
-const std::string &Operand::getSymbol() const
+const StringRef &Operand::getSymbol() const
 {
     return symbol;
 }
@@ -164,7 +137,7 @@ bool Operand::isValid() const
     return valid;
 }
 
-const std::string &Operand::getValue() const
+const StringRef &Operand::getValue() const
 {
     return value;
 }
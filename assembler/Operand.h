@@ -5,19 +5,27 @@
 #ifndef SS_OPERAND_H
 #define SS_OPERAND_H
 
-#include <string>
+#include <cstdint>
+#include <sys/types.h>
+#include "../common/StringRef.h"
 
+// Parsed operand, value and symbol point into the text it was parsed from
 class Operand
 {
 public:
-    enum OperandType {NONE, ABS_VAL, SYMB_VAL, SYMB, REGISTER, REGISTER_OFFS_ABS, REGISTER_OFFS_SYM, PCREL, MEMDIR};
+    enum OperandType : uint8_t {NONE, ABS_VAL, SYMB_VAL, SYMB, REGISTER, REGISTER_OFFS_ABS, REGISTER_OFFS_SYM, PCREL, MEMDIR};
 
-    explicit Operand(std::string value);
+    explicit Operand(const StringRef &value);
+    Operand(OperandType type, int32_t numericValue, uint registerId, const StringRef &symbol);
     Operand();
 
 protected:
-    std::string value;
+    StringRef value;
+    StringRef symbol;
+    int32_t numericValue;
+    uint registerId;
     OperandType type;
+    bool valid;
 public:
     OperandType getType() const;
 
@@ -25,17 +33,11 @@ public:
 
     uint getRegisterId() const;
 
-    const std::string &getSymbol() const;
+    const StringRef &getSymbol() const;
 
     bool isValid() const;
 
-    const std::string &getValue() const;
-
-protected:
-    int32_t numericValue;
-    uint registerId;
-    std::string symbol;
-    bool valid;
+    const StringRef &getValue() const;
 };
 
 
@@ -0,0 +1,292 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <cstring>
+#include "Optimizer.h"
+#include "Assembler.h"
+
+Optimizer::Optimizer()
+        : removedInstructions(0), savedBytes(0)
+{
+}
+
+bool Optimizer::optimize(const std::vector<Line> &source)
+{
+    lines = source;
+    removedInstructions = 0;
+    savedBytes = 0;
+    // Offsets like add pc, 4 count bytes, removing anything could break them
+    for (auto &line:lines)
+    {
+        uint8_t cnd;
+        auto name = decode(line, cnd);
+        if (name != nullptr && (strcmp(name, "add") == 0 || strcmp(name, "sub") == 0) &&
+            line.getArg0().getType() == Operand::REGISTER &&
+            line.getArg0().getRegisterId() == PC_REGISTER &&
+            line.getArg1().getType() == Operand::ABS_VAL)
+        {
+            warnings.push_back("Line " + std::to_string(line.getNumber()) +
+                               ": numeric pc offset, optimization skipped");
+            return false;
+        }
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            if (lines[i].getType() != Line::INSTRUCTION) continue;
+            if (foldConstant(i) || removeIdentity(i) || removeJumpToNext(i) || forwardPush(i))
+            {
+                changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+// mov rx, a; op rx, b -> mov rx, a op b. Both store through the 16 bit
+// path, so the flags match as long as add, sub and mul don't overflow.
+bool Optimizer::foldConstant(size_t index)
+{
+    uint8_t cnd;
+    auto name = decode(lines[index], cnd);
+    const auto &dst = lines[index].getArg0();
+    int32_t a, b;
+    if (name == nullptr || cnd != 3 || strcmp(name, "mov") != 0 ||
+        dst.getType() != Operand::REGISTER || dst.getRegisterId() >= PC_REGISTER ||
+        !immediate(lines[index].getArg1(), a))
+    {
+        return false;
+    }
+    auto next = nextInstruction(index);
+    if (next == NOT_FOUND) return false;
+    auto op = decode(lines[next], cnd);
+    if (op == nullptr || cnd != 3 || lines[next].getArg0().getType() != Operand::REGISTER ||
+        lines[next].getArg0().getRegisterId() != dst.getRegisterId() ||
+        !immediate(lines[next].getArg1(), b))
+    {
+        return false;
+    }
+    int32_t result;
+    if (strcmp(op, "shl") == 0 && b >= 0 && b < 16) result = (int16_t)((uint32_t)a << b);
+    else if (strcmp(op, "shr") == 0 && b >= 0 && b < 16) result = a >> b;
+    else if (strcmp(op, "and") == 0) result = a & b;
+    else if (strcmp(op, "or") == 0) result = a | b;
+    else if (strcmp(op, "add") == 0) result = a + b;
+    else if (strcmp(op, "sub") == 0) result = a - b;
+    else if (strcmp(op, "mul") == 0) result = a * b;
+    else return false;
+    if (result > INT16_MAX || result < INT16_MIN) return false;
+    replace(index, Line(lines[index], "mov", dst,
+                        Operand(Operand::ABS_VAL, result, 0, StringRef())));
+    remove(next);
+    return true;
+}
+
+// Instructions that only set flags: add rx, 0, mov rx, rx and the like
+bool Optimizer::removeIdentity(size_t index)
+{
+    uint8_t cnd;
+    auto name = decode(lines[index], cnd);
+    const auto &dst = lines[index].getArg0();
+    const auto &src = lines[index].getArg1();
+    if (name == nullptr || cnd != 3 || dst.getType() != Operand::REGISTER ||
+        dst.getRegisterId() >= PC_REGISTER)
+    {
+        return false;
+    }
+    int32_t value;
+    bool identity;
+    if (strcmp(name, "mov") == 0)
+    {
+        identity = src.getType() == Operand::REGISTER && src.getRegisterId() == dst.getRegisterId();
+    }
+    else if (!immediate(src, value))
+    {
+        identity = false;
+    }
+    else if (strcmp(name, "add") == 0 || strcmp(name, "sub") == 0 || strcmp(name, "or") == 0 ||
+             strcmp(name, "shl") == 0 || strcmp(name, "shr") == 0)
+    {
+        identity = value == 0;
+    }
+    else if (strcmp(name, "mul") == 0 || strcmp(name, "div") == 0)
+    {
+        identity = value == 1;
+    }
+    else
+    {
+        identity = strcmp(name, "and") == 0 && value == -1;
+    }
+    if (!identity || !flagsDead(index)) return false;
+    remove(index);
+    return true;
+}
+
+// jmp to a label that is already the next instruction
+bool Optimizer::removeJumpToNext(size_t index)
+{
+    uint8_t cnd;
+    auto name = decode(lines[index], cnd);
+    const auto &target = lines[index].getArg0();
+    if (name == nullptr || cnd != 3 || strcmp(name, "jmp") != 0 ||
+        (target.getType() != Operand::PCREL && target.getType() != Operand::SYMB &&
+         target.getType() != Operand::SYMB_VAL))
+    {
+        return false;
+    }
+    bool found = false;
+    for (size_t i = index + 1; i < lines.size() && !found; i++)
+    {
+        if (lines[i].getLabel() == target.getSymbol()) found = true;
+        if (lines[i].getType() != Line::EMPTY && lines[i].getType() != Line::LABEL_ONLY) break;
+    }
+    if (!found || !flagsDead(index)) return false;
+    remove(index);
+    return true;
+}
+
+// push rx; pop ry -> mov ry, rx, both set the flags from the moved value
+bool Optimizer::forwardPush(size_t index)
+{
+    uint8_t cnd;
+    auto name = decode(lines[index], cnd);
+    const auto &src = lines[index].getArg0();
+    if (name == nullptr || cnd != 3 || strcmp(name, "push") != 0 ||
+        src.getType() != Operand::REGISTER || src.getRegisterId() >= SP_REGISTER)
+    {
+        return false;
+    }
+    auto next = nextInstruction(index);
+    if (next == NOT_FOUND) return false;
+    auto op = decode(lines[next], cnd);
+    const auto &dst = lines[next].getArg0();
+    if (op == nullptr || cnd != 3 || strcmp(op, "pop") != 0 ||
+        dst.getType() != Operand::REGISTER || dst.getRegisterId() >= SP_REGISTER)
+    {
+        return false;
+    }
+    if (src.getRegisterId() == dst.getRegisterId())
+    {
+        if (!flagsDead(next)) return false;
+        remove(index);
+        remove(next);
+        return true;
+    }
+    replace(index, Line(lines[index], "mov", dst, src));
+    remove(next);
+    return true;
+}
+
+bool Optimizer::flagsDead(size_t index) const
+{
+    for (size_t i = index + 1; i < lines.size(); i++)
+    {
+        auto type = lines[i].getType();
+        if (type == Line::EMPTY || type == Line::LABEL_ONLY) continue;
+        if (type != Line::INSTRUCTION) return false;
+        uint8_t cnd;
+        auto name = decode(lines[i], cnd);
+        if (name == nullptr || cnd != 3) return false;
+        if (usesPsw(lines[i].getArg0()) || usesPsw(lines[i].getArg1())) return false;
+        if (strcmp(name, "push") == 0 || strcmp(name, "blkmov") == 0 || strcmp(name, "blkset") == 0) continue;
+        if (strcmp(name, "call") == 0 || strcmp(name, "iret") == 0 ||
+            strcmp(name, "ret") == 0 || strcmp(name, "jmp") == 0)
+        {
+            return false;
+        }
+        return !(lines[i].getArg0().getType() == Operand::REGISTER &&
+                 lines[i].getArg0().getRegisterId() == PC_REGISTER);
+    }
+    return false;
+}
+
+// Next instruction if nothing but empty lines separate it from this one
+size_t Optimizer::nextInstruction(size_t index) const
+{
+    size_t i = index + 1;
+    while (i < lines.size() && lines[i].getType() == Line::EMPTY) i++;
+    if (i < lines.size() && lines[i].getType() == Line::INSTRUCTION &&
+        lines[i].getLabel().empty())
+    {
+        return i;
+    }
+    return NOT_FOUND;
+}
+
+void Optimizer::remove(size_t index)
+{
+    savedBytes += sizeOf(lines[index]);
+    removedInstructions++;
+    lines[index] = Line(lines[index], lines[index].getLabel().empty() ? Line::EMPTY : Line::LABEL_ONLY);
+}
+
+void Optimizer::replace(size_t index, const Line &line)
+{
+    savedBytes += sizeOf(lines[index]) - sizeOf(line);
+    lines[index] = line;
+}
+
+const char *Optimizer::decode(const Line &line, uint8_t &condition)
+{
+    if (line.getType() != Line::INSTRUCTION) return nullptr;
+    return Assembler::decodeInstruction(line.getInstruction(), condition);
+}
+
+uint16_t Optimizer::sizeOf(const Line &line)
+{
+    uint8_t cnd;
+    auto name = decode(line, cnd);
+    if (name != nullptr && strcmp(name, "jmp") == 0) return 4;
+    // Packed instructions keep the operation in a second word
+    if (name != nullptr && (strcmp(name, "bswap") == 0 ||
+                            (name[0] == 'p' && strcmp(name, "push") != 0 && strcmp(name, "pop") != 0)))
+    {
+        return 4;
+    }
+    for (auto op:{line.getArg0().getType(), line.getArg1().getType()})
+    {
+        if (op != Operand::NONE && op != Operand::REGISTER) return 4;
+    }
+    return 2;
+}
+
+bool Optimizer::immediate(const Operand &op, int32_t &value)
+{
+    if (op.getType() != Operand::ABS_VAL || op.getNumericValue() > INT16_MAX ||
+        op.getNumericValue() < INT16_MIN)
+    {
+        return false;
+    }
+    value = op.getNumericValue();
+    return true;
+}
+
+bool Optimizer::usesPsw(const Operand &op)
+{
+    return (op.getType() == Operand::REGISTER || op.getType() == Operand::REGISTER_OFFS_ABS ||
+            op.getType() == Operand::REGISTER_OFFS_SYM) && op.getRegisterId() >= PSW_REGISTER;
+}
+
+const std::vector<Line> &Optimizer::getLines() const
+{
+    return lines;
+}
+
+uint Optimizer::getRemovedInstructions() const
+{
+    return removedInstructions;
+}
+
+uint Optimizer::getSavedBytes() const
+{
+    return savedBytes;
+}
+
+const std::vector<std::string> &Optimizer::getWarnings() const
+{
+    return warnings;
+}
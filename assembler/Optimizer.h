@@ -0,0 +1,60 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_OPTIMIZER_H
+#define SS_OPTIMIZER_H
+
+#include <string>
+#include <vector>
+#include "Line.h"
+
+// Peephole pass over parsed lines, run before the assembler encodes them.
+// Rewrites only straight-line code: the second instruction of a pair may not
+// carry a label, symbols are never folded, and an instruction whose flags
+// could still be observed is kept. Every instruction here except push, call,
+// iret, blkmov and blkset sets N/Z/C/V, so flags are dead when a later
+// unconditional flag setter is reached before any conditional instruction,
+// psw operand or jump.
+class Optimizer
+{
+public:
+    Optimizer();
+
+    // False if the lines can't be optimized safely, see getWarnings()
+    bool optimize(const std::vector<Line> &source);
+
+    const std::vector<Line> &getLines() const;
+
+    uint getRemovedInstructions() const;
+
+    uint getSavedBytes() const;
+
+    const std::vector<std::string> &getWarnings() const;
+
+protected:
+    static const size_t NOT_FOUND = (size_t)-1;
+
+    bool foldConstant(size_t index);
+    bool removeIdentity(size_t index);
+    bool removeJumpToNext(size_t index);
+    bool forwardPush(size_t index);
+
+    bool flagsDead(size_t index) const;
+    size_t nextInstruction(size_t index) const;
+    void remove(size_t index);
+    void replace(size_t index, const Line &line);
+
+    static const char *decode(const Line &line, uint8_t &condition);
+    static uint16_t sizeOf(const Line &line);
+    static bool immediate(const Operand &op, int32_t &value);
+    static bool usesPsw(const Operand &op);
+
+    std::vector<Line> lines;
+    std::vector<std::string> warnings;
+    uint removedInstructions;
+    uint savedBytes;
+};
+
+
+#endif //SS_OPTIMIZER_H
@@ -0,0 +1,426 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "generator/Generator.h"
+#include "linker/Linker.h"
+#include "emulator/Machine.h"
+#include "libss/libss.h"
+
+// Where the guest benchmark and stdlib are assembled, stdlib keeps the IV table at 0
+#define GUEST_START_ADDRESS 4096
+#define GUEST_MAX_STEPS 100000000
+
+struct Options
+{
+    std::string assembler;
+    std::string outfile;
+    std::string workdir;
+    std::vector<unsigned> sizes={1000, 2000, 4000, 8000, 16000};
+    std::vector<unsigned> modules={1, 2, 4, 8, 16, 32};
+    unsigned linkLines=8000;
+    unsigned repeat=3;
+    std::string guest;
+    std::string stdlib;
+};
+
+struct Run
+{
+    double seconds;
+    long peakRss;
+};
+
+bool parseList(const char *arg, std::vector<unsigned> &values)
+{
+    values.clear();
+    std::istringstream iss(arg);
+    std::string item;
+    while(std::getline(iss, item, ','))
+    {
+        auto value=atoi(item.c_str());
+        if(value<=0)
+        {
+            std::cerr<<"Invalid list "<<arg<<"\n";
+            return false;
+        }
+        values.push_back((unsigned)value);
+    }
+    return !values.empty();
+}
+
+bool getArgs(int argc, char **argv, Options &options)
+{
+    int opt;
+    while((opt=getopt(argc, argv, "a:o:d:n:m:l:r:g:L:"))!=-1)
+    {
+        if(opt=='?')
+        {
+            std::cerr<< "Format "<<argv[0]<<" [-a SSAS][-o OUTPUT_FILE][-d WORK_DIR][-n SIZES][-m MODULES][-l LINES][-r REPEAT]"
+                       "[-g GUEST_SOURCE][-L STDLIB]\n";
+            std::cerr<<"Arguments:\n-a SSAS (optional, default ssas next to this program)";
+            std::cerr<<"\n-o OUTPUT_FILE (optional, JSON results, default standard output)";
+            std::cerr<<"\n-d WORK_DIR (optional, default a new directory in /tmp, generated files are removed)";
+            std::cerr<<"\n-n SIZES (optional, default 1000,2000,4000,8000,16000, lines per assembled file)";
+            std::cerr<<"\n-m MODULES (optional, default 1,2,4,8,16,32, module counts to link)";
+            std::cerr<<"\n-l LINES (optional, default 8000, lines shared by the linked modules)";
+            std::cerr<<"\n-r REPEAT (optional, default 3, the fastest run counts)";
+            std::cerr<<"\n-g GUEST_SOURCE (optional, run the program and count instructions in each global routine, ";
+            std::cerr<<"pairing NAME_scalar with NAME_packed)";
+            std::cerr<<"\n-L STDLIB (optional, default stdlib.txt next to GUEST_SOURCE)";
+            return false;
+        }
+        switch(opt)
+        {
+            case 'a':
+                options.assembler=optarg;
+                break;
+            case 'o':
+                options.outfile=optarg;
+                break;
+            case 'd':
+                options.workdir=optarg;
+                break;
+            case 'n':
+                if(!parseList(optarg, options.sizes)) return false;
+                break;
+            case 'm':
+                if(!parseList(optarg, options.modules)) return false;
+                break;
+            case 'l':
+                options.linkLines=(unsigned)atoi(optarg);
+                break;
+            case 'r':
+                options.repeat=(unsigned)atoi(optarg);
+                break;
+            case 'g':
+                options.guest=optarg;
+                break;
+            case 'L':
+                options.stdlib=optarg;
+                break;
+            default:
+                break;
+        }
+    }
+    if(options.repeat==0) options.repeat=1;
+    if(options.assembler.empty())
+    {
+        std::string self=argv[0];
+        auto slash=self.find_last_of('/');
+        options.assembler=(slash==std::string::npos ? "" : self.substr(0, slash+1))+"ssas";
+    }
+    if(!options.guest.empty() && options.stdlib.empty())
+    {
+        auto slash=options.guest.find_last_of('/');
+        options.stdlib=(slash==std::string::npos ? "" : options.guest.substr(0, slash+1))+"stdlib.txt";
+    }
+    return true;
+}
+
+bool readFile(const std::string &fileName, std::string &contents)
+{
+    std::ifstream ifs(fileName);
+    std::stringstream buffer;
+    buffer<<ifs.rdbuf();
+    contents=buffer.str();
+    return !ifs.fail();
+}
+
+bool writeFile(const std::string &fileName, const std::string &contents)
+{
+    std::ofstream ofs(fileName);
+    ofs<<contents;
+    return !ofs.fail();
+}
+
+long fileSize(const std::string &fileName)
+{
+    struct stat st;
+    if(stat(fileName.c_str(), &st)!=0) return -1;
+    return (long)st.st_size;
+}
+
+// Runs the tool with its output discarded, peak RSS comes from the kernel
+bool runTool(const std::string &tool, const std::vector<std::string> &args, Run &run)
+{
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(tool.c_str()));
+    for(auto &arg:args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    auto begin=std::chrono::steady_clock::now();
+    pid_t pid=fork();
+    if(pid<0) return false;
+    if(pid==0)
+    {
+        int null=open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execv(tool.c_str(), argv.data());
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage)!=pid) return false;
+    run.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+    run.peakRss=usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status)==0;
+}
+
+bool bestRun(const Options &options, const std::vector<std::string> &args, Run &best)
+{
+    for(unsigned i=0;i<options.repeat;i++)
+    {
+        Run run;
+        if(!runTool(options.assembler, args, run)) return false;
+        if(i==0 || run.seconds<best.seconds) best.seconds=run.seconds;
+        if(i==0 || run.peakRss>best.peakRss) best.peakRss=run.peakRss;
+    }
+    return true;
+}
+
+bool benchAssembler(const Options &options, std::ostream &json, std::vector<std::string> &created)
+{
+    json<<"  \"assemble\": [";
+    bool first=true;
+    for(auto lines:options.sizes)
+    {
+        Generator::Options generatorOptions;
+        generatorOptions.lines=lines;
+        auto source=options.workdir+"/gen"+std::to_string(lines)+".s";
+        auto object=options.workdir+"/gen"+std::to_string(lines)+".o";
+        if(!writeFile(source, Generator(generatorOptions).module(0))) return false;
+        created.push_back(source);
+        created.push_back(object);
+        for(auto singlePass:{true, false})
+        {
+            std::vector<std::string> args={"-c", "", "-o", object};
+            if(singlePass) args.push_back("-1");
+            args.push_back(source);
+            Run run;
+            if(!bestRun(options, args, run))
+            {
+                std::cerr<<options.assembler<<" failed on "<<source<<"\n";
+                return false;
+            }
+            json<<(first ? "\n" : ",\n");
+            first=false;
+            json<<"    {\"lines\": "<<lines<<", \"mode\": \""<<(singlePass ? "single-pass" : "two-pass")
+                <<"\", \"seconds\": "<<run.seconds<<", \"lines_per_second\": "<<(long)(lines/run.seconds)
+                <<", \"peak_rss_kb\": "<<run.peakRss<<", \"source_bytes\": "<<fileSize(source)
+                <<", \"object_bytes\": "<<fileSize(object)<<"}";
+        }
+    }
+    json<<"\n  ],\n";
+    return true;
+}
+
+// Times what ssemu does before running: link the objects and load the image
+bool benchLinker(const Options &options, std::ostream &json, std::vector<std::string> &created)
+{
+    json<<"  \"link\": [";
+    bool first=true;
+    for(auto modules:options.modules)
+    {
+        Generator::Options generatorOptions;
+        generatorOptions.modules=modules;
+        generatorOptions.lines=options.linkLines/modules;
+        Generator generator(generatorOptions);
+        std::vector<std::string> objects;
+        long objectBytes=0;
+        for(unsigned i=0;i<modules;i++)
+        {
+            auto name=options.workdir+"/link"+std::to_string(modules)+"_"+std::to_string(i);
+            if(!writeFile(name+".s", generator.module(i))) return false;
+            created.push_back(name+".s");
+            created.push_back(name+".o");
+            Run run;
+            if(!runTool(options.assembler, {"-s", std::to_string(WORD_SIZE*IVT_SIZE), "-o", name+".o", name+".s"}, run))
+            {
+                std::cerr<<options.assembler<<" failed on "<<name<<".s\n";
+                return false;
+            }
+            objects.push_back(name+".o");
+            objectBytes+=fileSize(name+".o");
+        }
+        double best=0;
+        size_t symbols=0;
+        for(unsigned r=0;r<options.repeat;r++)
+        {
+            auto begin=std::chrono::steady_clock::now();
+            Linker linker;
+            linker.setAutoPlace(true);
+            if(!linker.addFiles(objects) || !linker.link())
+            {
+                for(const auto &error:linker.getErrors())
+                {
+                    std::cerr<<error<<"\n";
+                }
+                return false;
+            }
+            auto image=linker.getImage();
+            Machine machine;
+            if(!machine.load(image)) return false;
+            double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+            if(r==0 || seconds<best) best=seconds;
+            symbols=image.getSymbols().size();
+        }
+        json<<(first ? "\n" : ",\n");
+        first=false;
+        json<<"    {\"modules\": "<<modules<<", \"lines\": "<<generatorOptions.lines*modules
+            <<", \"global_symbols\": "<<symbols<<", \"object_bytes\": "<<objectBytes
+            <<", \"seconds\": "<<best<<"}";
+    }
+    json<<"\n  ]";
+    return true;
+}
+
+bool assembleGuest(const std::string &fileName, uint16_t startAddress, ObjectFile &object)
+{
+    std::string source;
+    if(!readFile(fileName, source))
+    {
+        std::cerr<<"Failed to open input file "<<fileName<<"\n";
+        return false;
+    }
+    ss::AssembleOptions assembleOptions;
+    assembleOptions.startAddress=startAddress;
+    std::vector<std::string> errors;
+    std::vector<std::string> warnings;
+    bool assembled=ss::assemble(source, object, errors, warnings, assembleOptions, fileName);
+    for(const auto &warning:warnings)
+    {
+        std::cerr<<fileName<<": "<<warning<<"\n";
+    }
+    if(assembled) return true;
+    for(const auto &error:errors)
+    {
+        std::cerr<<fileName<<": "<<error<<"\n";
+    }
+    return false;
+}
+
+// Instructions executed from each global symbol up to the next one, so kernels
+// should be leaf routines
+bool benchGuest(const Options &options, std::ostream &json)
+{
+    std::vector<ObjectFile> objects(2);
+    if(!assembleGuest(options.guest, GUEST_START_ADDRESS, objects[0]) ||
+       !assembleGuest(options.stdlib, 0, objects[1]))
+    {
+        return false;
+    }
+    Image image;
+    std::vector<std::string> errors;
+    if(!ss::link(objects, image, errors))
+    {
+        for(const auto &error:errors)
+        {
+            std::cerr<<error<<"\n";
+        }
+        return false;
+    }
+    Machine machine;
+    std::ostringstream screen;
+    machine.setOutput(screen);
+    machine.setProfile(true);
+    if(!machine.load(image) || !machine.runHeadless("", GUEST_MAX_STEPS))
+    {
+        std::cerr<<options.guest<<" did not halt\n";
+        return false;
+    }
+    std::vector<std::pair<uint16_t, std::string>> routines;
+    for(const auto &symbol:image.getSymbols())
+    {
+        routines.emplace_back(symbol.second, symbol.first);
+    }
+    std::sort(routines.begin(), routines.end());
+    std::map<std::string, uint64_t> counts;
+    const auto &profile=machine.getProfile();
+    for(uint32_t address=0;address<profile.size();address++)
+    {
+        if(profile[address]==0) continue;
+        auto next=std::upper_bound(routines.begin(), routines.end(), std::make_pair((uint16_t)address, std::string()),
+                                   [](const std::pair<uint16_t, std::string> &a,
+                                      const std::pair<uint16_t, std::string> &b) { return a.first<b.first; });
+        if(next!=routines.begin()) counts[std::prev(next)->second]+=profile[address];
+    }
+    json<<",\n  \"guest\": {\"source\": \""<<options.guest<<"\", \"instructions\": "<<machine.getSteps()
+        <<", \"kernels\": [";
+    bool first=true;
+    static const std::string scalar="_scalar";
+    for(const auto &count:counts)
+    {
+        const auto &name=count.first;
+        if(name.length()<=scalar.length() || name.compare(name.length()-scalar.length(), scalar.length(), scalar)!=0)
+        {
+            continue;
+        }
+        auto kernel=name.substr(0, name.length()-scalar.length());
+        auto packed=counts.find(kernel+"_packed");
+        if(packed==counts.end() || packed->second==0) continue;
+        json<<(first ? "\n" : ",\n");
+        first=false;
+        json<<"    {\"kernel\": \""<<kernel<<"\", \"scalar_instructions\": "<<count.second
+            <<", \"packed_instructions\": "<<packed->second
+            <<", \"speedup\": "<<(double)count.second/packed->second<<"}";
+    }
+    json<<"\n  ]}";
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if(!getArgs(argc, argv, options))
+    {
+        return -1;
+    }
+    bool temporary=options.workdir.empty();
+    if(temporary)
+    {
+        char dir[]="/tmp/ssbench.XXXXXX";
+        if(mkdtemp(dir)==nullptr)
+        {
+            std::cerr<<"Failed to create a work directory\n";
+            return -1;
+        }
+        options.workdir=dir;
+    }
+    std::ostringstream json;
+    std::vector<std::string> created;
+    json<<"{\n  \"assembler\": \""<<options.assembler<<"\",\n  \"repeat\": "<<options.repeat<<",\n";
+    bool ok=benchAssembler(options, json, created) && benchLinker(options, json, created) &&
+            (options.guest.empty() || benchGuest(options, json));
+    json<<"\n}\n";
+    for(auto &fileName:created)
+    {
+        unlink(fileName.c_str());
+    }
+    if(temporary) rmdir(options.workdir.c_str());
+    if(!ok) return -1;
+    if(options.outfile.empty())
+    {
+        std::cout<<json.str();
+        return 0;
+    }
+    if(!writeFile(options.outfile, json.str()))
+    {
+        std::cerr<<"Failed to open output file "<<options.outfile<<"\n";
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Cache.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+CacheKey::CacheKey()
+:hash(FNV_OFFSET_BASIS)
+{
+
+}
+
+void CacheKey::add(const void *data, size_t size)
+{
+    auto bytes=(const uint8_t*)data;
+    auto h=hash;
+    for(size_t i=0;i<size;i++)
+    {
+        h^=bytes[i];
+        h*=FNV_PRIME;
+    }
+    hash=h;
+}
+
+void CacheKey::add(const std::string &str)
+{
+    add((uint64_t)str.length());
+    add(str.data(), str.length());
+}
+
+void CacheKey::add(uint64_t value)
+{
+    uint8_t bytes[8];
+    for(int i=0;i<8;i++)
+    {
+        bytes[i]=(uint8_t)(value>>(8u*i));
+    }
+    add(bytes, sizeof(bytes));
+}
+
+bool CacheKey::addFile(const std::string &fileName)
+{
+    int fd=open(fileName.c_str(), O_RDONLY);
+    if(fd<0) return false;
+    struct stat st;
+    if(fstat(fd, &st)!=0)
+    {
+        close(fd);
+        return false;
+    }
+    auto size=(size_t)st.st_size;
+    add((uint64_t)size);
+    if(size==0)
+    {
+        close(fd);
+        return true;
+    }
+    void *buffer=mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(buffer==MAP_FAILED) return false;
+    add(buffer, size);
+    munmap(buffer, size);
+    return true;
+}
+
+std::string CacheKey::toString() const
+{
+    std::ostringstream oss;
+    oss<<std::hex<<std::setw(16)<<std::setfill('0')<<hash;
+    return oss.str();
+}
+
+Cache::Cache(const std::string &directory)
+:directory(directory), enabled(false)
+{
+    if(directory.empty()) return;
+    // Create every missing component of the path, another process may be doing the same
+    for(size_t position=directory.find('/', 1);;position=directory.find('/', position+1))
+    {
+        auto component=directory.substr(0, position);
+        if(mkdir(component.c_str(), 0777)!=0 && errno!=EEXIST) return;
+        if(position==std::string::npos) break;
+    }
+    struct stat st;
+    enabled=stat(directory.c_str(), &st)==0 && S_ISDIR(st.st_mode) && access(directory.c_str(), W_OK)==0;
+}
+
+std::string Cache::defaultDirectory()
+{
+    auto dir=getenv("SS_CACHE_DIR");
+    if(dir) return dir;
+    return "";
+}
+
+uint64_t Cache::defaultLimit()
+{
+    auto limit=getenv("SS_CACHE_LIMIT");
+    if(limit && strtoull(limit, nullptr, 10)>0) return strtoull(limit, nullptr, 10);
+    return CACHE_DEFAULT_LIMIT;
+}
+
+bool Cache::isEnabled() const
+{
+    return enabled;
+}
+
+std::string Cache::entryPath(const CacheKey &key, const std::string &extension) const
+{
+    return directory+"/"+key.toString()+extension;
+}
+
+std::string Cache::temporaryPath(const CacheKey &key) const
+{
+    static std::atomic<unsigned> counter(0);
+    std::ostringstream oss;
+    oss<<directory<<"/"<<key.toString()<<".tmp."<<getpid()<<"."<<counter++;
+    return oss.str();
+}
+
+bool Cache::publish(const std::string &temporaryPath, const std::string &entryPath) const
+{
+    if(rename(temporaryPath.c_str(), entryPath.c_str())!=0)
+    {
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void Cache::touch(const std::string &entryPath) const
+{
+    utimensat(AT_FDCWD, entryPath.c_str(), nullptr, 0);
+}
+
+void Cache::trim(uint64_t limit) const
+{
+    if(!enabled) return;
+    DIR *dir=opendir(directory.c_str());
+    if(dir==nullptr) return;
+    std::vector<std::pair<time_t, std::pair<uint64_t, std::string> > > entries;
+    uint64_t total=0;
+    auto now=time(nullptr);
+    while(auto entry=readdir(dir))
+    {
+        std::string name=entry->d_name;
+        if(name=="." || name=="..") continue;
+        auto path=directory+"/"+name;
+        struct stat st;
+        if(stat(path.c_str(), &st)!=0 || !S_ISREG(st.st_mode)) continue;
+        if(name.find(".tmp.")!=std::string::npos)
+        {
+            if(now-st.st_mtime>CACHE_TEMPORARY_LIFETIME) unlink(path.c_str());
+            continue;
+        }
+        total+=(uint64_t)st.st_size;
+        entries.push_back({st.st_mtime, {(uint64_t)st.st_size, path}});
+    }
+    closedir(dir);
+    if(total<=limit) return;
+    std::sort(entries.begin(), entries.end());
+    for(auto &entry:entries)
+    {
+        if(total<=limit) break;
+        unlink(entry.second.second.c_str());
+        total-=entry.second.first;
+    }
+}
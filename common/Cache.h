@@ -0,0 +1,59 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_CACHE_H
+#define SS_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Bytes a cache directory may hold before trim removes the oldest entries
+#define CACHE_DEFAULT_LIMIT (64ull<<20u)
+// Temporary files older than this many seconds belong to writers that died
+#define CACHE_TEMPORARY_LIFETIME 3600
+
+// Incremental 64 bit FNV-1a hash used to build cache keys
+class CacheKey
+{
+public:
+    CacheKey();
+    void add(const void *data, size_t size);
+    void add(const std::string &str);
+    void add(uint64_t value);
+    bool addFile(const std::string &fileName);
+    std::string toString() const;
+
+protected:
+    uint64_t hash;
+};
+
+// On-disk cache directory shared between processes. Entries are written to
+// a private temporary file and renamed into place, so readers only ever
+// see complete entries and concurrent writers of the same key are harmless.
+class Cache
+{
+public:
+    explicit Cache(const std::string &directory);
+    static std::string defaultDirectory();
+    // $SS_CACHE_LIMIT in bytes, or CACHE_DEFAULT_LIMIT
+    static uint64_t defaultLimit();
+
+    bool isEnabled() const;
+    std::string entryPath(const CacheKey &key, const std::string &extension) const;
+    std::string temporaryPath(const CacheKey &key) const;
+    bool publish(const std::string &temporaryPath, const std::string &entryPath) const;
+    // Marks an entry as used, trim removes the least recently used entries first
+    void touch(const std::string &entryPath) const;
+    // Deletes entries, oldest first, until the directory holds at most limit bytes.
+    // Safe while other processes use the cache, their open entries stay readable.
+    void trim(uint64_t limit) const;
+
+protected:
+    std::string directory;
+    bool enabled;
+};
+
+
+#endif //SS_CACHE_H
@@ -0,0 +1,221 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Image.h"
+#include "machine_params.h"
+
+static void put16(std::vector<uint8_t> &buffer, uint16_t value)
+{
+    buffer.push_back((uint8_t)(value&255u));
+    buffer.push_back((uint8_t)(value>>8u));
+}
+
+static bool get16(const uint8_t *buffer, size_t size, size_t &position, uint16_t &value)
+{
+    if(position+2>size) return false;
+    value=buffer[position] | (buffer[position+1]<<8u);
+    position+=2;
+    return true;
+}
+
+Image::Image()
+:valid(true), entry(0)
+{
+
+}
+
+Image::Image(const std::string &fileName)
+:valid(false), entry(0)
+{
+    int fd=open(fileName.c_str(), O_RDONLY);
+    if(fd<0) return;
+    struct stat st;
+    if(fstat(fd, &st)!=0 || st.st_size==0)
+    {
+        close(fd);
+        return;
+    }
+    auto size=(size_t)st.st_size;
+    void *buffer=mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(buffer==MAP_FAILED) return;
+    valid=parse((const uint8_t*)buffer, size);
+    munmap(buffer, size);
+}
+
+bool Image::isImage(const std::string &fileName)
+{
+    std::ifstream ifs(fileName, std::ios_base::in | std::ios_base::binary);
+    char magic[IMAGE_MAGIC_SIZE];
+    if(!ifs.read(magic, IMAGE_MAGIC_SIZE)) return false;
+    return memcmp(magic, IMAGE_MAGIC, IMAGE_MAGIC_SIZE)==0 || memcmp(magic, IMAGE_MAGIC_V1, IMAGE_MAGIC_SIZE)==0;
+}
+
+bool Image::parse(const uint8_t *buffer, size_t size)
+{
+    if(size<IMAGE_MAGIC_SIZE) return false;
+    bool hasLines=memcmp(buffer, IMAGE_MAGIC, IMAGE_MAGIC_SIZE)==0;
+    if(!hasLines && memcmp(buffer, IMAGE_MAGIC_V1, IMAGE_MAGIC_SIZE)!=0) return false;
+    size_t position=IMAGE_MAGIC_SIZE;
+    uint16_t segmentCount;
+    uint16_t symbolCount;
+    if(!get16(buffer, size, position, entry)) return false;
+    if(!get16(buffer, size, position, segmentCount)) return false;
+    if(!get16(buffer, size, position, symbolCount)) return false;
+    uint32_t dataSize=0;
+    for(int i=0;i<segmentCount;i++)
+    {
+        Segment segment;
+        if(!get16(buffer, size, position, segment.start)) return false;
+        if(!get16(buffer, size, position, segment.length)) return false;
+        if((uint32_t)segment.start+segment.length>MEMORY_SIZE) return false;
+        segment.dataOffset=dataSize;
+        dataSize+=segment.length;
+        segments.push_back(segment);
+    }
+    for(int i=0;i<symbolCount;i++)
+    {
+        uint16_t address;
+        if(!get16(buffer, size, position, address)) return false;
+        if(position>=size) return false;
+        uint8_t nameLength=buffer[position++];
+        if(position+nameLength>size) return false;
+        symbols[std::string((const char*)buffer+position, nameLength)]=address;
+        position+=nameLength;
+    }
+    if(hasLines && !lines.decode(buffer, size, position)) return false;
+    if(position+dataSize!=size) return false;
+    data.assign(buffer+position, buffer+size);
+    return true;
+}
+
+bool Image::isWritable(std::string &reason) const
+{
+    if(segments.size()>IMAGE_MAX_COUNT)
+    {
+        reason="Image has "+std::to_string(segments.size())+" segments, at most "+std::to_string(IMAGE_MAX_COUNT)+" fit";
+        return false;
+    }
+    if(symbols.size()>IMAGE_MAX_COUNT)
+    {
+        reason="Image has "+std::to_string(symbols.size())+" symbols, at most "+std::to_string(IMAGE_MAX_COUNT)+" fit";
+        return false;
+    }
+    for(auto &symbol:symbols)
+    {
+        if(symbol.first.length()>IMAGE_MAX_NAME_LENGTH)
+        {
+            reason="Symbol name "+symbol.first.substr(0, 32)+"... is longer than "+
+                   std::to_string(IMAGE_MAX_NAME_LENGTH)+" bytes";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Image::write(const std::string &fileName) const
+{
+    std::string reason;
+    if(!isWritable(reason)) return false;
+    std::vector<uint8_t> buffer(IMAGE_MAGIC, IMAGE_MAGIC+IMAGE_MAGIC_SIZE);
+    put16(buffer, entry);
+    put16(buffer, (uint16_t)segments.size());
+    put16(buffer, (uint16_t)symbols.size());
+    for(auto &segment:segments)
+    {
+        put16(buffer, segment.start);
+        put16(buffer, segment.length);
+    }
+    for(auto &symbol:symbols)
+    {
+        put16(buffer, symbol.second);
+        buffer.push_back((uint8_t)symbol.first.length());
+        buffer.insert(buffer.end(), symbol.first.begin(), symbol.first.end());
+    }
+    lines.encode(buffer);
+    buffer.insert(buffer.end(), data.begin(), data.end());
+    std::ofstream ofs(fileName, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if(ofs.fail()) return false;
+    ofs.write((const char*)buffer.data(), buffer.size());
+    return !ofs.fail();
+}
+
+void Image::writeMap(std::ostream &stream) const
+{
+    auto flags=stream.flags();
+    stream<<"ENTRY: "<<entry<<"\n";
+    stream<<"SEGMENTS:\n";
+    stream<<"Start           Length\n";
+    for(auto &segment:segments)
+    {
+        stream<<std::setw(16)<<std::left<<segment.start;
+        stream<<segment.length<<"\n";
+    }
+    stream<<"SYMBOLS:\n";
+    stream<<"Name            Address\n";
+    for(auto &symbol:symbols)
+    {
+        stream<<std::setw(16)<<std::left<<symbol.first;
+        stream<<symbol.second<<"\n";
+    }
+    stream.flags(flags);
+}
+
+void Image::addSegment(uint16_t start, const std::vector<uint8_t> &bytes)
+{
+    segments.push_back({start, (uint16_t)bytes.size(), (uint32_t)data.size()});
+    data.insert(data.end(), bytes.begin(), bytes.end());
+}
+
+void Image::addSymbol(const std::string &name, uint16_t address)
+{
+    symbols[name]=address;
+}
+
+void Image::addLine(const std::string &fileName, uint16_t address, uint32_t line)
+{
+    lines.add(fileName, address, line);
+}
+
+bool Image::isValid() const
+{
+    return valid;
+}
+
+uint16_t Image::getEntry() const
+{
+    return entry;
+}
+
+void Image::setEntry(uint16_t entry)
+{
+    Image::entry = entry;
+}
+
+const std::vector<Image::Segment> &Image::getSegments() const
+{
+    return segments;
+}
+
+const std::map<std::string, uint16_t> &Image::getSymbols() const
+{
+    return symbols;
+}
+
+const uint8_t *Image::getSegmentData(const Image::Segment &segment) const
+{
+    return data.data()+segment.dataOffset;
+}
+
+const LineTable &Image::getLines() const
+{
+    return lines;
+}
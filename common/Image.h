@@ -0,0 +1,73 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_IMAGE_H
+#define SS_IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include "LineTable.h"
+
+#define IMAGE_MAGIC "SSIMG02\n"
+// Images from before the line table, still loadable
+#define IMAGE_MAGIC_V1 "SSIMG01\n"
+#define IMAGE_MAGIC_SIZE 8
+// Symbol names are stored with a one byte length, counts in 16 bits
+#define IMAGE_MAX_NAME_LENGTH UINT8_MAX
+#define IMAGE_MAX_COUNT UINT16_MAX
+
+class Image
+{
+public:
+    struct Segment
+    {
+        uint16_t start;
+        uint16_t length;
+        uint32_t dataOffset;
+    };
+
+    Image();
+    explicit Image(const std::string &fileName);
+    static bool isImage(const std::string &fileName);
+
+    // False without writing anything when the image doesn't fit the format
+    bool write(const std::string &fileName) const;
+    // Why write would refuse the image, false if it wouldn't
+    bool isWritable(std::string &reason) const;
+    void writeMap(std::ostream &stream) const;
+
+    void addSegment(uint16_t start, const std::vector<uint8_t> &bytes);
+    void addSymbol(const std::string &name, uint16_t address);
+    void addLine(const std::string &fileName, uint16_t address, uint32_t line);
+
+protected:
+    bool valid;
+    uint16_t entry;
+    std::vector<Segment> segments;
+    std::map<std::string, uint16_t> symbols;
+    std::vector<uint8_t> data;
+    LineTable lines;
+
+    bool parse(const uint8_t *buffer, size_t size);
+public:
+    bool isValid() const;
+
+    uint16_t getEntry() const;
+
+    void setEntry(uint16_t entry);
+
+    const std::vector<Segment> &getSegments() const;
+
+    const std::map<std::string, uint16_t> &getSymbols() const;
+
+    const uint8_t *getSegmentData(const Segment &segment) const;
+
+    const LineTable &getLines() const;
+};
+
+
+#endif //SS_IMAGE_H
@@ -0,0 +1,122 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include "LineTable.h"
+
+static void putVarint(std::vector<uint8_t> &buffer, uint32_t value)
+{
+    while(value>=128u)
+    {
+        buffer.push_back((uint8_t)(value|128u));
+        value>>=7u;
+    }
+    buffer.push_back((uint8_t)value);
+}
+
+static bool getVarint(const uint8_t *buffer, size_t size, size_t &position, uint32_t &value)
+{
+    value=0;
+    for(unsigned shift=0;shift<32;shift+=7)
+    {
+        if(position>=size) return false;
+        uint8_t byte=buffer[position++];
+        value|=(uint32_t)(byte&127u)<<shift;
+        if((byte&128u)==0) return true;
+    }
+    return false;
+}
+
+void LineTable::add(const std::string &fileName, uint16_t address, uint32_t line)
+{
+    auto file=std::find(files.begin(), files.end(), fileName);
+    if(file==files.end()) file=files.insert(files.end(), fileName);
+    locations[address]={(uint16_t)(file-files.begin()), line};
+}
+
+bool LineTable::find(uint16_t address, std::string &fileName, uint32_t &line) const
+{
+    auto location=locations.find(address);
+    if(location==locations.end()) return false;
+    fileName=files[location->second.file];
+    line=location->second.line;
+    return true;
+}
+
+std::string LineTable::describe(uint16_t address) const
+{
+    std::string fileName;
+    uint32_t line;
+    if(!find(address, fileName, line)) return "";
+    return fileName+":"+std::to_string(line);
+}
+
+bool LineTable::empty() const
+{
+    return locations.empty();
+}
+
+void LineTable::encode(std::vector<uint8_t> &buffer) const
+{
+    putVarint(buffer, (uint32_t)files.size());
+    for(auto &file:files)
+    {
+        putVarint(buffer, (uint32_t)file.length());
+        buffer.insert(buffer.end(), file.begin(), file.end());
+    }
+    putVarint(buffer, (uint32_t)locations.size());
+    uint16_t address=0;
+    uint32_t line=0;
+    for(auto &location:locations)
+    {
+        auto lineDelta=(int32_t)(location.second.line-line);
+        putVarint(buffer, (uint32_t)(location.first-address));
+        putVarint(buffer, location.second.file);
+        putVarint(buffer, ((uint32_t)lineDelta<<1u)^(uint32_t)(lineDelta>>31));
+        address=location.first;
+        line=location.second.line;
+    }
+}
+
+bool LineTable::decode(const uint8_t *buffer, size_t size, size_t &position)
+{
+    files.clear();
+    locations.clear();
+    uint32_t fileCount;
+    if(!getVarint(buffer, size, position, fileCount)) return false;
+    for(uint32_t i=0;i<fileCount;i++)
+    {
+        uint32_t length;
+        if(!getVarint(buffer, size, position, length) || position+length>size) return false;
+        files.emplace_back((const char*)buffer+position, length);
+        position+=length;
+    }
+    uint32_t count;
+    if(!getVarint(buffer, size, position, count)) return false;
+    uint32_t address=0;
+    uint32_t line=0;
+    for(uint32_t i=0;i<count;i++)
+    {
+        uint32_t addressDelta;
+        uint32_t file;
+        uint32_t lineDelta;
+        if(!getVarint(buffer, size, position, addressDelta) || !getVarint(buffer, size, position, file) ||
+           !getVarint(buffer, size, position, lineDelta)) return false;
+        address+=addressDelta;
+        line+=(lineDelta>>1u)^(uint32_t)-(int32_t)(lineDelta&1u);
+        if(address>UINT16_MAX || file>=files.size()) return false;
+        locations[(uint16_t)address]={(uint16_t)file, line};
+    }
+    return true;
+}
+
+const std::vector<std::string> &LineTable::getFiles() const
+{
+    return files;
+}
+
+const std::map<uint16_t, LineTable::Location> &LineTable::getLocations() const
+{
+    return locations;
+}
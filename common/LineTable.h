@@ -0,0 +1,45 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_LINETABLE_H
+#define SS_LINETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Maps instruction addresses of a linked program to the source lines they
+// were assembled from. Stored in images sorted by address, every entry as
+// varint deltas from the previous one.
+class LineTable
+{
+public:
+    struct Location
+    {
+        uint16_t file;
+        uint32_t line;
+    };
+
+    void add(const std::string &fileName, uint16_t address, uint32_t line);
+    bool find(uint16_t address, std::string &fileName, uint32_t &line) const;
+    // file:line, or an empty string when the address has no line
+    std::string describe(uint16_t address) const;
+    bool empty() const;
+
+    void encode(std::vector<uint8_t> &buffer) const;
+    bool decode(const uint8_t *buffer, size_t size, size_t &position);
+
+protected:
+    std::vector<std::string> files;
+    std::map<uint16_t, Location> locations;
+public:
+    const std::vector<std::string> &getFiles() const;
+
+    const std::map<uint16_t, Location> &getLocations() const;
+};
+
+
+#endif //SS_LINETABLE_H
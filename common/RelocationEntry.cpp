@@ -4,32 +4,53 @@
 
 #include <regex>
 #include "RelocationEntry.h"
+#include "StringTable.h"
 
-std::regex LINE_REGEX(R"(^([A-Za-z_\.][A-Za-z0-9_]*)\s*([A-Za-z_\.][A-Za-z0-9_]*)\s*([0-9]+)\s*([A-Za-z_\.][A-Za-z0-9_]*)$)");
+std::regex LINE_REGEX(R"(^([A-Za-z_\.][A-Za-z0-9_]*)\s*([A-Za-z_\.][A-Za-z0-9_]*)\s*([0-9]+)\s*(ABS|REL)([124])$)");
 uint16_t RelocationEntry::getOffset() const
 {
     return offset;
 }
 
 const std::string &RelocationEntry::getTargetSymbol() const
+{
+    return StringTable::lookup(targetSymbol);
+}
+
+uint32_t RelocationEntry::getTargetSymbolId() const
 {
     return targetSymbol;
 }
 
-const std::string &RelocationEntry::getType() const
+RelocationEntry::Type RelocationEntry::getType() const
 {
     return type;
 }
 
+uint16_t RelocationEntry::getLength() const
+{
+    return length;
+}
+
+std::string RelocationEntry::getTypeName() const
+{
+    return (type==ABS ? "ABS" : "REL")+std::to_string(length);
+}
+
 const std::string &RelocationEntry::getSection() const
+{
+    return StringTable::lookup(section);
+}
+
+uint32_t RelocationEntry::getSectionId() const
 {
     return section;
 }
 
 RelocationEntry::RelocationEntry(uint16_t offset,
-                                 const std::string &targetSymbol,
-                                 const std::string &type, const std::string &section)
-:offset(offset), targetSymbol(targetSymbol), type(type), section(section)
+                                 uint32_t targetSymbol,
+                                 Type type, uint16_t length, uint32_t section)
+:offset(offset), targetSymbol(targetSymbol), type(type), length(length), section(section)
 {
 
 }
@@ -42,10 +63,11 @@ RelocationEntry::RelocationEntry(const std::string &line, bool &valid)
         valid=false;
         return;
     }
-    targetSymbol=match[1];
-    section=match[2];
+    targetSymbol=StringTable::intern(match[1]);
+    section=StringTable::intern(match[2]);
     std::string offsStr=match[3];
     offset=atoi(offsStr.c_str());
-    type=match[4];
-    valid = type == "ABS1" || type == "ABS2" || type == "ABS4" || type == "REL2";
+    type=match[4]=="ABS" ? ABS : REL;
+    length=(uint16_t)(match[5].str()[0]-'0');
+    valid = type==ABS || length==2;
 }
@@ -12,22 +12,33 @@
 class RelocationEntry
 {
 public:
-    RelocationEntry(uint16_t offset, const std::string &targetSymbol, const std::string &type, const std::string &section);
+    enum Type{ABS, REL};
+
+    RelocationEntry(uint16_t offset, uint32_t targetSymbol, Type type, uint16_t length, uint32_t section);
     RelocationEntry(const std::string &line, bool &valid);
 
     uint16_t getOffset() const;
 
     const std::string &getTargetSymbol() const;
 
-    const std::string &getType() const;
+    uint32_t getTargetSymbolId() const;
+
+    Type getType() const;
+
+    uint16_t getLength() const;
+
+    std::string getTypeName() const;
 
     const std::string &getSection() const;
 
+    uint32_t getSectionId() const;
+
 protected:
     uint16_t offset;
-    std::string targetSymbol;
-    std::string type;
-    std::string section;
+    uint32_t targetSymbol;
+    Type type;
+    uint16_t length;
+    uint32_t section;
 };
 
 
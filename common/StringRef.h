@@ -0,0 +1,139 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_STRINGREF_H
+#define SS_STRINGREF_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+// Non-owning view of a character range, the owner must outlive it
+class StringRef
+{
+public:
+    StringRef()
+    :ptr(""), len(0)
+    {
+
+    }
+
+    StringRef(const char *data, size_t length)
+    :ptr(data), len(length)
+    {
+
+    }
+
+    StringRef(const char *str)
+    :ptr(str), len(strlen(str))
+    {
+
+    }
+
+    StringRef(const std::string &str)
+    :ptr(str.data()), len(str.length())
+    {
+
+    }
+
+    const char *data() const
+    {
+        return ptr;
+    }
+
+    size_t length() const
+    {
+        return len;
+    }
+
+    bool empty() const
+    {
+        return len==0;
+    }
+
+    char operator[](size_t index) const
+    {
+        return ptr[index];
+    }
+
+    const char *begin() const
+    {
+        return ptr;
+    }
+
+    const char *end() const
+    {
+        return ptr+len;
+    }
+
+    StringRef substr(size_t position, size_t length=std::string::npos) const
+    {
+        if(position>len) position=len;
+        if(length>len-position) length=len-position;
+        return StringRef(ptr+position, length);
+    }
+
+    std::string str() const
+    {
+        return std::string(ptr, len);
+    }
+
+    operator std::string() const
+    {
+        return str();
+    }
+
+    bool operator==(const StringRef &other) const
+    {
+        return len==other.len && memcmp(ptr, other.ptr, len)==0;
+    }
+
+    bool operator!=(const StringRef &other) const
+    {
+        return !(*this==other);
+    }
+
+    bool operator==(const char *other) const
+    {
+        return *this==StringRef(other);
+    }
+
+    bool operator!=(const char *other) const
+    {
+        return !(*this==StringRef(other));
+    }
+
+    bool operator==(const std::string &other) const
+    {
+        return *this==StringRef(other);
+    }
+
+    bool operator!=(const std::string &other) const
+    {
+        return !(*this==StringRef(other));
+    }
+
+protected:
+    const char *ptr;
+    size_t len;
+};
+
+inline std::string operator+(const std::string &left, const StringRef &right)
+{
+    return left+right.str();
+}
+
+inline std::string operator+(const char *left, const StringRef &right)
+{
+    return left+right.str();
+}
+
+inline std::ostream &operator<<(std::ostream &stream, const StringRef &str)
+{
+    return stream.write(str.data(), str.length());
+}
+
+
+#endif //SS_STRINGREF_H
@@ -0,0 +1,97 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include "StringTable.h"
+
+StringTable::StringTable()
+:count(0)
+{
+    for(auto &block:blocks)
+    {
+        block.store(nullptr, std::memory_order_relaxed);
+    }
+    for(auto name:{"UNKNOWN", ".text", ".data", ".rodata", ".bss"})
+    {
+        ids[name]=append(name);
+    }
+}
+
+StringTable::~StringTable()
+{
+    for(auto &block:blocks)
+    {
+        delete[] block.load(std::memory_order_relaxed);
+    }
+}
+
+StringTable &StringTable::instance()
+{
+    static StringTable table;
+    return table;
+}
+
+void StringTable::locate(uint32_t id, unsigned &block, uint32_t &index)
+{
+    block=0;
+    index=id;
+    while(index>=FIRST_BLOCK_SIZE<<block)
+    {
+        index-=FIRST_BLOCK_SIZE<<block;
+        block++;
+    }
+}
+
+// Called with the mutex held; the string is in place before count says so
+uint32_t StringTable::append(const std::string &str)
+{
+    auto id=count.load(std::memory_order_relaxed);
+    unsigned block;
+    uint32_t index;
+    locate(id, block, index);
+    auto strings=blocks[block].load(std::memory_order_relaxed);
+    if(strings==nullptr)
+    {
+        strings=new std::string[FIRST_BLOCK_SIZE<<block];
+        blocks[block].store(strings, std::memory_order_release);
+    }
+    strings[index]=str;
+    count.store(id+1, std::memory_order_release);
+    return id;
+}
+
+uint32_t StringTable::intern(const std::string &str)
+{
+    auto &table=instance();
+    std::lock_guard<std::mutex> lck(table.mtx);
+    auto iter=table.ids.find(str);
+    if(iter!=table.ids.end()) return iter->second;
+    auto id=table.append(str);
+    table.ids[str]=id;
+    return id;
+}
+
+bool StringTable::find(const std::string &str, uint32_t &id)
+{
+    auto &table=instance();
+    std::lock_guard<std::mutex> lck(table.mtx);
+    auto iter=table.ids.find(str);
+    if(iter==table.ids.end()) return false;
+    id=iter->second;
+    return true;
+}
+
+const std::string &StringTable::lookup(uint32_t id)
+{
+    auto &table=instance();
+    if(id>=table.count.load(std::memory_order_acquire)) id=UNKNOWN;
+    unsigned block;
+    uint32_t index;
+    locate(id, block, index);
+    return table.blocks[block].load(std::memory_order_acquire)[index];
+}
+
+bool StringTable::isSection(uint32_t id)
+{
+    return id>UNKNOWN && id<SECTION_COUNT;
+}
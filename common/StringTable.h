@@ -0,0 +1,48 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_STRINGTABLE_H
+#define SS_STRINGTABLE_H
+
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Process wide table of interned symbol and section names.
+// The section names the machine knows about always get the same small ids,
+// so they can be used to index arrays directly.
+// Strings are kept in blocks that never move, so lookup doesn't lock. Nothing
+// is ever removed either: a long running process that keeps interning new
+// names, like a libss fuzz loop, grows the table for as long as it runs.
+class StringTable
+{
+public:
+    enum PredefinedId : uint32_t {UNKNOWN=0, TEXT=1, DATA=2, RODATA=3, BSS=4, SECTION_COUNT=5};
+
+    static uint32_t intern(const std::string &str);
+    static bool find(const std::string &str, uint32_t &id);
+    static const std::string &lookup(uint32_t id);
+    static bool isSection(uint32_t id);
+
+protected:
+    // Block b holds FIRST_BLOCK_SIZE<<b strings
+    static const uint32_t FIRST_BLOCK_SIZE=1024;
+    static const unsigned BLOCK_COUNT=22;
+
+    StringTable();
+    ~StringTable();
+    static StringTable &instance();
+    static void locate(uint32_t id, unsigned &block, uint32_t &index);
+    uint32_t append(const std::string &str);
+    std::mutex mtx;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::atomic<std::string*> blocks[BLOCK_COUNT];
+    std::atomic<uint32_t> count;
+};
+
+
+#endif //SS_STRINGTABLE_H
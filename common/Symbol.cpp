@@ -3,19 +3,25 @@
 //
 
 #include "Symbol.h"
+#include "StringTable.h"
 #include <regex>
 
 std::regex SYMBOL_LINE(R"(^([0-9]+)\s*([A-Za-z_\.][A-Za-z0-9_]*)\s*([A-Za-z_\.][A-Za-z0-9_]*)\s*([0-9]+)\s*([0-9]+)\s*([A-Za-z]+)$)");
 
 
-Symbol::Symbol(const std::string &name, Symbol::Type type, const std::string &section, uint16_t offset,
+Symbol::Symbol(const std::string &name, Symbol::Type type, uint32_t section, uint16_t offset,
                bool global, int seq, uint16_t length)
-:name(name), type(type), section(section), offset(offset), global(global), seq(seq), length(length)
+:name(StringTable::intern(name)), type(type), section(section), offset(offset), global(global), seq(seq), length(length)
 {
 
 }
 
 const std::string &Symbol::getName() const
+{
+    return StringTable::lookup(name);
+}
+
+uint32_t Symbol::getNameId() const
 {
     return name;
 }
@@ -26,6 +32,11 @@ const Symbol::Type Symbol::getType() const
 }
 
 const std::string& Symbol::getSection() const
+{
+    return StringTable::lookup(section);
+}
+
+uint32_t Symbol::getSectionId() const
 {
     return section;
 }
@@ -56,7 +67,7 @@ const int Symbol::getSeq() const
 }
 
 Symbol::Symbol()
-:name(""),seq(-1),type(Symbol::LABEL)
+:name(StringTable::intern("")),seq(-1),type(Symbol::LABEL),section(StringTable::UNKNOWN)
 {
 
 }
@@ -81,8 +92,8 @@ Symbol::Symbol(const std::string &line, bool &valid)
     }
     std::string seqStr=match[1];
     seq=atoi(seqStr.c_str());
-    name=match[2];
-    section=match[3];
+    name=StringTable::intern(match[2]);
+    section=StringTable::intern(match[3]);
     std::string offsStr=match[4];
     offset=atoi(offsStr.c_str());
     std::string lenStr=match[5];
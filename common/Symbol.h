@@ -5,20 +5,21 @@
 #ifndef SS_SYMBOL_H
 #define SS_SYMBOL_H
 
+#include <cstdint>
 #include <string>
 
 class Symbol
 {
 public:
     enum Type{LABEL, SECTION};
-    Symbol(const std::string &name, Type type, const std::string &section, uint16_t offset, bool global, int seq, uint16_t length);
+    Symbol(const std::string &name, Type type, uint32_t section, uint16_t offset, bool global, int seq, uint16_t length);
     Symbol(const std::string &line, bool &valid);
     Symbol();
 
 protected:
-    std::string name;
+    uint32_t name;
     Type type;
-    std::string section;
+    uint32_t section;
     int seq;
     uint16_t offset;
     uint16_t length;
@@ -26,6 +27,8 @@ protected:
 public:
     const std::string &getName() const;
 
+    uint32_t getNameId() const;
+
     uint16_t getLength() const;
 
     void setLength(uint16_t length);
@@ -34,6 +37,8 @@ public:
 
     const std::string& getSection() const;
 
+    uint32_t getSectionId() const;
+
     int getOffset() const;
 
     bool isGlobal() const;
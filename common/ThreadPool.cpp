@@ -0,0 +1,69 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads)
+:task(nullptr), next(0), count(0), done(0), generation(0), stopping(false)
+{
+    if(threads==0) threads=std::thread::hardware_concurrency();
+    if(threads==0) threads=1;
+    for(unsigned i=0;i<threads;i++)
+    {
+        workers.emplace_back(ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        stopping=true;
+    }
+    wakeup.notify_all();
+    for(auto &thread:workers)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &task)
+{
+    if(count==0) return;
+    std::unique_lock<std::mutex> lck(mtx);
+    this->task=&task;
+    this->count=count;
+    next=0;
+    done=0;
+    generation++;
+    wakeup.notify_all();
+    finished.wait(lck, [this]{return done==this->count;});
+    this->task=nullptr;
+}
+
+unsigned ThreadPool::getSize() const
+{
+    return (unsigned)workers.size();
+}
+
+void ThreadPool::worker(ThreadPool *pool)
+{
+    unsigned seen=0;
+    std::unique_lock<std::mutex> lck(pool->mtx);
+    while(true)
+    {
+        pool->wakeup.wait(lck, [pool, seen]{return pool->stopping || pool->generation!=seen;});
+        if(pool->stopping) return;
+        seen=pool->generation;
+        while(pool->next<pool->count)
+        {
+            size_t index=pool->next++;
+            auto task=pool->task;
+            lck.unlock();
+            (*task)(index);
+            lck.lock();
+            if(++pool->done==pool->count) pool->finished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,42 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_THREADPOOL_H
+#define SS_THREADPOOL_H
+
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads=0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool &operator=(const ThreadPool&)=delete;
+
+    void run(size_t count, const std::function<void(size_t)> &task);
+
+    unsigned getSize() const;
+
+protected:
+    static void worker(ThreadPool *pool);
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    const std::function<void(size_t)> *task;
+    size_t next;
+    size_t count;
+    size_t done;
+    unsigned generation;
+    bool stopping;
+};
+
+
+#endif //SS_THREADPOOL_H
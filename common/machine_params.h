@@ -15,6 +15,33 @@
 #define MAX_PROGRAM_SIZE (MEMORY_SIZE-IO_SEGMENT_SIZE)
 #define WORD_SIZE 2
 #define IVT_SIZE 16
+// Bytes under the initial SP that automatic placement leaves for the stack
+#define STACK_RESERVE 4096
 #define SCREEN_OUT 0xfffe
 #define KBD_IN 0xfffc
+// Writing a service number here runs a hypercall, its status is read back from here
+#define HYPERCALL_PORT 0xfff8
+// Address of the hypercall argument block
+#define HYPERCALL_ARGS 0xfffa
+// Immediates an ABS operand field of 1-6 stands for, 0 means a second word follows
+#define SHORT_IMMEDIATES {0, 0, 1, 2, 4, 8, -1}
+#define SHORT_IMMEDIATE_COUNT 7
+// iret's opcode with a register-direct first operand is a block instruction,
+// the register field picks which. R0 is the destination, R1 the source or the
+// fill byte and R2 the length in bytes.
+#define BLOCK_OPCODE 12
+#define BLOCK_MOVE 0
+#define BLOCK_FILL 1
+// Bytes a block instruction moves before pending interrupts are taken
+#define BLOCK_CHUNK_SIZE 64
+// With a register-direct first operand and an immediate second operand it is
+// a packed instruction on the two bytes of the first register. The immediate
+// holds the operation from bit 3 up and the source register below it.
+#define PACKED_ADD 0
+#define PACKED_SUB 1
+#define PACKED_CMPEQ 2
+#define PACKED_MIN 3
+#define PACKED_MAX 4
+#define PACKED_SWAP 5
+#define PACKED_OPERATION_SHIFT 3
 #endif //SS_MACHINE_PARAMS_H
@@ -3,100 +3,192 @@
 //
 
 #include <cstdlib>
-#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <unistd.h>
+#include <getopt.h>
 #include "emulator/Memory.h"
 #include "emulator/Machine.h"
-#include "common/Symbol.h"
-#include "common/RelocationEntry.h"
-#include "emulator/File.h"
+#include "common/Image.h"
+#include "common/Cache.h"
+#include "linker/Linker.h"
 
 #define CNT 104857600
 uint16_t v[CNT];
 uint16_t a[CNT];
-int main(int argc, char **argv)
+
+bool linkFiles(bool autoPlace, bool gc, const std::vector<std::string> &infiles, Image &image)
 {
-    std::vector<File> files;
-    if(argc<2)
-    {
-        std::cerr<<"No input files given\n";
-        return -1;
-    }
-    for(int i=1;i<argc;i++)
+    Linker linker;
+    linker.setAutoPlace(autoPlace);
+    linker.setCollectGarbage(gc);
+    if(!linker.addFiles(infiles) || !linker.link())
     {
-        std::ifstream ifs(argv[i]);
-        File f(ifs, argv[i]);
-        ifs.close();
-        if(!f.isValid())
+        for(const auto &error:linker.getErrors())
         {
-            std::cerr<<"File "<<argv[i]<<" is invalid2\n";
-            return -1;
+            std::cerr<<error<<"\n";
         }
-        files.push_back(f);
+        return false;
     }
-    std::sort(files.begin(), files.end(), [](const File &x1, const File &x2)->bool{return x1.getStart()<x2.getStart();});
-    std::string prevName="";
-    uint16_t prevEnd=0;
-    for(auto& file:files)
+    image=linker.getImage();
+    return true;
+}
+
+// Looks the inputs up in the image cache, links them and stores the result on a miss.
+// The key covers the linker version, the link options and the content of every input.
+// Returns false only when linking fails, a broken cache just falls back to linking.
+bool loadCached(const std::string &cacheDir, bool autoPlace, bool gc, const std::vector<std::string> &infiles,
+                Image &image)
+{
+    Cache cache(cacheDir);
+    CacheKey key;
+    key.add(std::string(IMAGE_MAGIC));
+    key.add((uint64_t)LINKER_VERSION);
+    key.add((uint64_t)autoPlace);
+    key.add((uint64_t)gc);
+    key.add((uint64_t)infiles.size());
+    bool hashed=cache.isEnabled();
+    for(auto &infile:infiles)
     {
-        if(file.getStart()<prevEnd)
-        {
-            std::cerr<<"Files "<<prevName<<" and "<<file.getName()<<" overlap \n";
-            return -1;
-        }
-        prevName=file.getName();
-        prevEnd=file.getStart()+file.getLength();
+        if(!hashed) break;
+        hashed=key.addFile(infile);
     }
-    std::unordered_map<std::string, Symbol> globalSymbols;
-    for(auto &file: files)
+    if(!hashed) return linkFiles(autoPlace, gc, infiles, image);
+    auto entry=cache.entryPath(key, ".img");
+    image=Image(entry);
+    if(image.isValid())
     {
-        for(auto &symbolPair:file.getSymbols())
-        {
-            if(symbolPair.second.isGlobal() &&
-                    symbolPair.second.getSection()!="UNKNOWN")
-            {
-                if(globalSymbols.count(symbolPair.first))
-                {
-                    std::cerr<<"Duplicate definition of "<<symbolPair.first<<"\n";
-                    return -1;
-                }
-                globalSymbols[symbolPair.first]=symbolPair.second;
-            }
-        }
+        cache.touch(entry);
+        return true;
+    }
+    if(!linkFiles(autoPlace, gc, infiles, image)) return false;
+    auto temporary=cache.temporaryPath(key);
+    if(image.write(temporary))
+    {
+        cache.publish(temporary, entry);
+        cache.trim(Cache::defaultLimit());
+    }
+    else
+    {
+        unlink(temporary.c_str());
     }
-    for(auto &file: files)
+    return true;
+}
+
+bool getArgs(int argc, char **argv, bool &autoPlace, bool &gc, bool &hle, std::string &cacheDir,
+             std::string &traceFile, std::string &profileFile, std::vector<std::string> &infiles)
+{
+    static const option longOptions[]={{"gc", no_argument, nullptr, 'g'}, {nullptr, 0, nullptr, 0}};
+    int opt;
+    while((opt=getopt_long(argc, argv, "pgHc:t:P:", longOptions, nullptr))!=-1)
     {
-        for(auto &symbolPair:file.getSymbols())
+        if(opt=='?')
         {
-            if(symbolPair.second.isGlobal() &&
-               symbolPair.second.getSection()=="UNKNOWN" &&
-               globalSymbols.count(symbolPair.first)==0)
-            {
-                std::cerr<<"Unresolved symbol "<<symbolPair.first;
-                return -1;
-            }
+            std::cerr<< "Format "<<argv[0]<<" [-p][--gc][-H][-c CACHE_DIR][-t TRACE_FILE][-P PROFILE_FILE] image | input_files...\n";
+            std::cerr<<"Arguments:\n-p (optional, place objects automatically after the IV table)";
+            std::cerr<<"\n-g, --gc (optional, drop code and data unreachable from START and the IV table)";
+            std::cerr<<"\n-H (optional, run unmodified stdlib printstr, printint and getchar natively)";
+            std::cerr<<"\n-c CACHE_DIR (optional, default $SS_CACHE_DIR, reuse linked images of identical inputs)";
+            std::cerr<<"\n-t TRACE_FILE (optional, write the address and source line of every executed instruction)";
+            std::cerr<<"\n-P PROFILE_FILE (optional, write executed instruction counts per source line)";
+            std::cerr<<"\nSource lines come from objects assembled with ssas -g";
+            return false;
+        }
+        switch(opt)
+        {
+            case 'g':
+                gc=true;
+                break;
+            case 'p':
+                autoPlace=true;
+                break;
+            case 'H':
+                hle=true;
+                break;
+            case 'c':
+                cacheDir=optarg;
+                break;
+            case 't':
+                traceFile=optarg;
+                break;
+            case 'P':
+                profileFile=optarg;
+                break;
+            default:
+                break;
         }
     }
-    if(globalSymbols.count("START")==0)
+    if(argc<=optind)
+    {
+        std::cerr<<"No input files given\n";
+        return false;
+    }
+    for(int i=optind;i<argc;i++)
+    {
+        infiles.push_back(argv[i]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool autoPlace=false;
+    bool gc=false;
+    bool hle=false;
+    std::string cacheDir=Cache::defaultDirectory();
+    std::string traceFile;
+    std::string profileFile;
+    std::vector<std::string> infiles;
+    if(!getArgs(argc, argv, autoPlace, gc, hle, cacheDir, traceFile, profileFile, infiles))
     {
-        std::cerr<<"Missing symbol START\n";
         return -1;
     }
-    for(auto &file: files)
+    Image image;
+    if(infiles.size()==1 && Image::isImage(infiles[0]))
     {
-        if(!file.relocate(globalSymbols, 0))
+        image=Image(infiles[0]);
+        if(!image.isValid())
         {
-            std::cerr<<"File "<<file.getName()<<" is invalid1\n";
+            std::cerr<<"Image "<<infiles[0]<<" is invalid\n";
             return -1;
-        };
+        }
+    }
+    else if(!loadCached(cacheDir, autoPlace, gc, infiles, image))
+    {
+        return -1;
     }
     Machine m;
-    for(auto &file: files)
+    if(!m.load(image))
     {
-        m.getMemory().blkwrite(file.getStart(), file.getStart()+file.getLength(), file.getCode());
+        std::cerr<<"Failed to load program into memory\n";
+        return -1;
     }
-    m.setRegister(PC_REGISTER, globalSymbols["START"].getOffset());
+    std::ofstream trace;
+    if(!traceFile.empty())
+    {
+        trace.open(traceFile);
+        if(trace.fail())
+        {
+            std::cerr<<"Failed to open trace file "<<traceFile<<"\n";
+            return -1;
+        }
+        m.setTrace(&trace);
+    }
+    m.setProfile(!profileFile.empty());
+    if(hle) m.enableHle(image);
     auto result = m.run();
+    if(!profileFile.empty())
+    {
+        std::ofstream profile(profileFile);
+        if(profile.fail())
+        {
+            std::cerr<<"Failed to open profile file "<<profileFile<<"\n";
+        }
+        else
+        {
+            m.writeProfile(profile);
+        }
+    }
     std::cout<<"\n";
     if(result)
     {
@@ -0,0 +1,51 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include "CostModel.h"
+#include "../common/machine_params.h"
+
+enum Opcode : unsigned {ADD=0, SUB=1, MUL=2, DIV=3, CMP=4, AND=5, OR=6, NOT=7, TEST=8, PUSH=9, POP=10, CALL=11,
+                        IRET=12, MOV=13, SHL=14, SHR=15};
+
+static bool inMemory(Instruction::OperandType type)
+{
+    return type==Instruction::MEMDIR || type==Instruction::REGIND;
+}
+
+unsigned InstructionCost::total() const
+{
+    return words+reads+writes+extra;
+}
+
+InstructionCost estimateCost(Instruction instruction)
+{
+    InstructionCost cost{instruction.needSecondWord() ? 2u : 1u, 0, 0, 0, false};
+    auto opcode=instruction.getOpcode();
+    if(instruction.isBlock())
+    {
+        // One word of the block, the rest depends on R2
+        cost.reads=instruction.getValue1()==BLOCK_MOVE ? 1 : 0;
+        cost.writes=1;
+        return cost;
+    }
+    if(instruction.isPacked())
+    {
+        cost.transfer=instruction.getValue1()==PC_REGISTER;
+        return cost;
+    }
+    bool readsFirst=opcode!=NOT && opcode!=MOV && opcode!=POP && opcode!=CALL && opcode!=IRET;
+    bool readsSecond=opcode!=PUSH && opcode!=POP && opcode!=CALL && opcode!=IRET;
+    bool storesFirst=opcode!=CMP && opcode!=TEST && opcode!=PUSH && opcode!=CALL && opcode!=IRET;
+    if(readsFirst && inMemory(instruction.getType1())) cost.reads++;
+    if(readsSecond && inMemory(instruction.getType2())) cost.reads++;
+    if(storesFirst && inMemory(instruction.getType1())) cost.writes++;
+    if(opcode==POP) cost.reads++;
+    if(opcode==IRET) cost.reads+=2;
+    if(opcode==PUSH || opcode==CALL) cost.writes++;
+    if(opcode==MUL) cost.extra=MUL_EXTRA_COST;
+    if(opcode==DIV) cost.extra=DIV_EXTRA_COST;
+    cost.transfer=opcode==CALL || opcode==IRET ||
+                  (storesFirst && instruction.getType1()==Instruction::REGDIR && instruction.getValue1()==PC_REGISTER);
+    return cost;
+}
@@ -0,0 +1,33 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_COSTMODEL_H
+#define SS_COSTMODEL_H
+
+#include "Instruction.h"
+
+// Extra cost of the multiply and divide units on top of memory accesses
+#define MUL_EXTRA_COST 4
+#define DIV_EXTRA_COST 12
+
+// Static cost of one instruction as the emulator executes it. Every memory
+// access counts one, instruction words included, so a register-direct op
+// costs 1 and mov r1, r0[0] costs 3. Block instructions are counted for a
+// single word.
+struct InstructionCost
+{
+    unsigned words;
+    unsigned reads;
+    unsigned writes;
+    unsigned extra;
+    // Writes PC, so the basic block ends here
+    bool transfer;
+
+    unsigned total() const;
+};
+
+InstructionCost estimateCost(Instruction instruction);
+
+
+#endif //SS_COSTMODEL_H
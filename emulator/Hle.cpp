@@ -0,0 +1,101 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include "Hle.h"
+#include "../common/Cache.h"
+#include "../common/machine_params.h"
+
+// Second words in this range are constants of the routine, others are addresses.
+// Addresses are hashed as offsets from the entry, which the linker keeps when
+// it moves stdlib, so a routine whose jumps or data references were changed
+// gets a different shape.
+#define HLE_MAX_CONSTANT 255
+#define HLE_ADD_OPCODE 0
+
+const HleKnownRoutine hleKnownRoutines[HLE_ROUTINE_COUNT]={
+        {"printstr", 11, {"2fef1c7247232a18", "828ccef0d2e7819f"}},
+        {"getchar",  8,  {"a513b7be56ce633f", "af61719984558b7a"}},
+        {"printint", 44, {"0735e210bb300692", "d1f560d4a516137d"}}};
+
+uint16_t HleBody::pcRelative(size_t i) const
+{
+    return (uint16_t)(addresses[i+1]+instructions[i].getSecondWord());
+}
+
+bool decodeBody(Memory &memory, uint16_t entry, size_t count, HleBody &body)
+{
+    body.instructions.clear();
+    body.addresses.clear();
+    uint16_t address=entry;
+    for(size_t i=0;i<count;i++)
+    {
+        uint16_t first;
+        if(!memory.read(address, first)) return false;
+        body.addresses.push_back(address);
+        Instruction instruction(first);
+        address+=WORD_SIZE;
+        if(!instruction.valid()) return false;
+        if(instruction.needSecondWord())
+        {
+            uint16_t second;
+            if(!memory.read(address, second)) return false;
+            instruction.putSecondWord(second);
+            address+=WORD_SIZE;
+        }
+        body.instructions.push_back(instruction);
+    }
+    body.addresses.push_back(address);
+    return true;
+}
+
+std::string shapeOf(const HleBody &body)
+{
+    CacheKey key;
+    uint16_t entry=body.addresses.front();
+    for(size_t i=0;i<body.instructions.size();i++)
+    {
+        auto instruction=body.instructions[i];
+        key.add((uint64_t)instruction.getCondition());
+        key.add((uint64_t)instruction.getOpcode());
+        key.add((uint64_t)instruction.getType1());
+        key.add((uint64_t)instruction.getValue1());
+        key.add((uint64_t)instruction.getType2());
+        key.add((uint64_t)instruction.getValue2());
+        if(!instruction.needSecondWord()) continue;
+        bool memdir=instruction.getType1()==Instruction::MEMDIR || instruction.getType2()==Instruction::MEMDIR;
+        bool pcRelative=(instruction.getType1()==Instruction::REGIND && instruction.getValue1()==PC_REGISTER) ||
+                        (instruction.getType2()==Instruction::REGIND && instruction.getValue2()==PC_REGISTER);
+        bool jump=instruction.getType1()==Instruction::REGDIR && instruction.getValue1()==PC_REGISTER;
+        auto word=instruction.getSecondWord();
+        auto value=(int16_t)word;
+        if(pcRelative)
+        {
+            key.add((uint64_t)(uint16_t)(body.pcRelative(i)-entry));
+        }
+        else if(jump && instruction.getOpcode()==HLE_ADD_OPCODE)
+        {
+            // add pc, n jumps relative to the next instruction
+            key.add((uint64_t)(uint16_t)(body.addresses[i+1]+word-entry));
+        }
+        else if(memdir || jump || value<-HLE_MAX_CONSTANT || value>HLE_MAX_CONSTANT)
+        {
+            key.add((uint64_t)(uint16_t)(word-entry));
+        }
+        else
+        {
+            key.add((uint64_t)word);
+        }
+    }
+    return key.toString();
+}
+
+bool isKnownShape(HleRoutine routine, const HleBody &body)
+{
+    auto shape=shapeOf(body);
+    for(auto known:hleKnownRoutines[routine].shapes)
+    {
+        if(shape==known) return true;
+    }
+    return false;
+}
@@ -0,0 +1,49 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_HLE_H
+#define SS_HLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "Memory.h"
+
+// Routines of stdlib.txt the emulator can run natively. A routine is only
+// taken over when the image defines its global and the code there has the
+// known shape: opcodes, conditions, operand types, registers, small
+// constants, and jump targets and addresses relative to the routine's entry.
+// The check holds wherever the linker placed stdlib as a whole.
+enum HleRoutine {HLE_PRINTSTR, HLE_GETCHAR, HLE_PRINTINT, HLE_ROUTINE_COUNT};
+
+struct HleBody
+{
+    std::vector<Instruction> instructions;
+    // Address of every instruction, then the address after the last one
+    std::vector<uint16_t> addresses;
+
+    // Address a PC-relative operand of instruction i refers to
+    uint16_t pcRelative(size_t i) const;
+};
+
+// Shapes of the routines as plain ssas and ssas -S encode them
+#define HLE_SHAPE_COUNT 2
+
+struct HleKnownRoutine
+{
+    const char *name;
+    size_t instructions;
+    const char *shapes[HLE_SHAPE_COUNT];
+};
+
+extern const HleKnownRoutine hleKnownRoutines[HLE_ROUTINE_COUNT];
+
+bool decodeBody(Memory &memory, uint16_t entry, size_t count, HleBody &body);
+std::string shapeOf(const HleBody &body);
+bool isKnownShape(HleRoutine routine, const HleBody &body);
+
+
+#endif //SS_HLE_H
@@ -0,0 +1,40 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_HYPERCALL_H
+#define SS_HYPERCALL_H
+
+// Services of the hypercall port. The guest stores the address of a block at
+// HYPERCALL_ARGS and then the service number at HYPERCALL_PORT. The first word
+// of the block receives the result, the arguments follow it. The host does the
+// work before the next instruction and leaves a status at HYPERCALL_PORT:
+// HYPERCALL_OK, or HYPERCALL_FAILED for bad arguments or unknown services, in
+// which case the result word is left alone. Every 16-bit result is thus a
+// valid value. Strings are one word per character ending with 0, as in stdlib.
+enum HypercallService
+{
+    // dst, src, bytes: copies like memmove, result dst
+    HYPERCALL_MEMCPY=1,
+    // dst, value, bytes: fills with the low byte of value, result dst
+    HYPERCALL_MEMSET=2,
+    // a, b: result -1, 0 or 1 as string a compares to b
+    HYPERCALL_STRCMP=3,
+    // value, dst: writes the decimal string, result its length
+    HYPERCALL_FORMAT_INT=4,
+    // src, end: parses an optional - and decimal digits, result the value,
+    // end gets the address after the last character used
+    HYPERCALL_PARSE_INT=5,
+    // src, count: writes count characters to the screen, all up to the 0 when
+    // count is 0, result the number written
+    HYPERCALL_WRITE=6,
+    // dst, count: moves up to count characters of pending keyboard input to
+    // dst without waiting or echoing, result the number moved
+    HYPERCALL_READ=7
+};
+
+#define HYPERCALL_OK 0
+#define HYPERCALL_FAILED 1
+
+
+#endif //SS_HYPERCALL_H
@@ -26,6 +26,9 @@ Instruction::Instruction(uint16_t firstWord)
         type2=REGDIR;
         value2=PSW_REGISTER;
     }
+    static const int16_t shortImmediates[SHORT_IMMEDIATE_COUNT]=SHORT_IMMEDIATES;
+    if(type1==ABS && value1!=0) secondWord=(uint16_t)shortImmediates[value1];
+    if(type2==ABS && value2!=0) secondWord=(uint16_t)shortImmediates[value2];
 }
 
 bool Instruction::valid()
@@ -36,11 +39,22 @@ bool Instruction::valid()
 
 bool Instruction::needSecondWord()
 {
-    if(type1==ABS && value1!=7 || type1==MEMDIR || type1==REGIND) return true;
-    if(type2==ABS && value2!=7 || type2==MEMDIR || type2==REGIND) return true;
+    if(type1==ABS && value1==0 || type1==MEMDIR || type1==REGIND) return true;
+    if(type2==ABS && value2==0 || type2==MEMDIR || type2==REGIND) return true;
     return false;
 }
 
+bool Instruction::isBlock() const
+{
+    return opcode==BLOCK_OPCODE && type1==REGDIR && value1!=PSW_REGISTER &&
+           type2==REGDIR && value2==PSW_REGISTER;
+}
+
+bool Instruction::isPacked() const
+{
+    return opcode==BLOCK_OPCODE && type1==REGDIR && value1!=PSW_REGISTER && type2==ABS && value2==0;
+}
+
 void Instruction::putSecondWord(uint16_t secondWord)
 {
     this->secondWord=secondWord;
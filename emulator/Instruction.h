@@ -19,6 +19,9 @@ public:
     void putSecondWord(uint16_t secondWord);
     bool valid();
     bool needSecondWord();
+    // Extensions sharing iret's opcode, see machine_params.h
+    bool isBlock() const;
+    bool isPacked() const;
 
     Condition getCondition() const;
 
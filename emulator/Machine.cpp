@@ -2,8 +2,11 @@
 // Created by nidzo on 3.6.18..
 //
 
+#include <algorithm>
 #include <thread>
 #include <iostream>
+#include <iomanip>
+#include <map>
 #include <termio.h>
 #include <zconf.h>
 #include <cstring>
@@ -17,6 +20,10 @@ Machine::Machine()
     registers[PC_REGISTER] = 32;
     for(int i=0;i<16;i++) interruptSignals[i]=false;
     running=false;
+    output=&std::cout;
+    trace=nullptr;
+    hleScreen=0;
+    steps=0;
     memory.write(KBD_IN, (uint8_t)0xff);
 }
 
@@ -34,10 +41,29 @@ bool Machine::getRegister(uint16_t reg, uint16_t &val)
     return true;
 }
 
+bool Machine::load(const Image &image)
+{
+    for(auto &segment:image.getSegments())
+    {
+        if(!memory.blkwrite(segment.start, image.getSegmentData(segment), segment.length)) return false;
+    }
+    registers[PC_REGISTER]=image.getEntry();
+    lines=image.getLines();
+    return true;
+}
+
 bool Machine::step()
 {
     std::lock_guard<std::recursive_mutex> lck(mtx);
     handleInterrupts();
+    auto pc=registers[PC_REGISTER];
+    if(trace) *trace<<pc<<" "<<lines.describe(pc)<<"\n";
+    if(!profile.empty()) profile[pc]++;
+    if(!hle.empty())
+    {
+        auto routine=hle.find(pc);
+        if(routine!=hle.end() && runHle(routine->second)) return true;
+    }
     Instruction ins;
     //std::cout<<registers[PC_REGISTER];
     if (!fetch(ins)) return false;
@@ -84,6 +110,245 @@ bool Machine::run()
     return true;
 }
 
+bool Machine::runHeadless(const std::string &input, uint64_t maxSteps)
+{
+    running=true;
+    steps=0;
+    pendingInput.assign(input.begin(), input.end());
+    uint64_t inputStep=HEADLESS_INPUT_STEPS;
+    interrupt(0);
+    while (registers[PSW_REGISTER] & (1u << 14u))
+    {
+        if(maxSteps!=0 && steps>=maxSteps)
+        {
+            running=false;
+            return false;
+        }
+        if(steps%HEADLESS_TIMER_STEPS==HEADLESS_TIMER_STEPS-1 && (registers[PSW_REGISTER]&(1<<13)))
+        {
+            notifyInterrupt(1);
+        }
+        if(!pendingInput.empty() && steps>=inputStep && notifyInterrupt(3))
+        {
+            memory.write(KBD_IN, pendingInput.front());
+            pendingInput.pop_front();
+            inputStep=steps+HEADLESS_INPUT_STEPS;
+        }
+        steps++;
+        if (!step() && !interrupt(2))
+        {
+            running=false;
+            return false;
+        }
+    }
+    running=false;
+    return true;
+}
+
+void Machine::setOutput(std::ostream &output)
+{
+    Machine::output=&output;
+}
+
+uint64_t Machine::getSteps() const
+{
+    return steps;
+}
+
+void Machine::setTrace(std::ostream *trace)
+{
+    Machine::trace=trace;
+}
+
+void Machine::setProfile(bool profile)
+{
+    Machine::profile.assign(profile ? MEMORY_SIZE : 0, 0);
+}
+
+const std::vector<uint64_t> &Machine::getProfile() const
+{
+    return profile;
+}
+
+void Machine::writeProfile(std::ostream &stream) const
+{
+    uint64_t total=0;
+    std::map<std::string, uint64_t> counts;
+    for(uint32_t address=0;address<profile.size();address++)
+    {
+        if(profile[address]==0) continue;
+        total+=profile[address];
+        auto location=lines.describe((uint16_t)address);
+        counts[location.empty() ? "address "+std::to_string(address) : location]+=profile[address];
+    }
+    std::vector<std::pair<uint64_t, std::string> > sorted;
+    for(auto &count:counts)
+    {
+        sorted.push_back({count.second, count.first});
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const std::pair<uint64_t, std::string> &c1, const std::pair<uint64_t, std::string> &c2)
+                     {
+                         return c1.first>c2.first;
+                     });
+    auto flags=stream.flags();
+    auto precision=stream.precision();
+    stream<<"PROFILE: "<<total<<" instructions\n";
+    stream<<"Count           Percent         Location\n";
+    for(auto &count:sorted)
+    {
+        stream<<std::setw(16)<<std::left<<count.first;
+        stream<<std::setw(16)<<std::left<<std::fixed<<std::setprecision(2)<<100.0*count.first/total;
+        stream<<count.second<<"\n";
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+unsigned Machine::enableHle(const Image &image)
+{
+    hle.clear();
+    bool found[HLE_ROUTINE_COUNT];
+    HleBody bodies[HLE_ROUTINE_COUNT];
+    uint16_t entries[HLE_ROUTINE_COUNT];
+    for(int r=0;r<HLE_ROUTINE_COUNT;r++)
+    {
+        auto &known=hleKnownRoutines[r];
+        auto symbol=image.getSymbols().find(known.name);
+        found[r]=symbol!=image.getSymbols().end() &&
+                 decodeBody(memory, symbol->second, known.instructions, bodies[r]) &&
+                 isKnownShape((HleRoutine)r, bodies[r]);
+        if(found[r]) entries[r]=symbol->second;
+    }
+    // printint prints through printstr, so it goes native only when its calls reach the native printstr
+    if(found[HLE_PRINTINT])
+    {
+        auto &body=bodies[HLE_PRINTINT];
+        for(size_t i=0;i<body.instructions.size() && found[HLE_PRINTINT];i++)
+        {
+            if(body.instructions[i].getOpcode()!=11) continue;
+            found[HLE_PRINTINT]=found[HLE_PRINTSTR] && body.pcRelative(i)==entries[HLE_PRINTSTR];
+        }
+    }
+    if(found[HLE_PRINTSTR]) hleScreen=bodies[HLE_PRINTSTR].pcRelative(4);
+    for(int r=0;r<HLE_ROUTINE_COUNT;r++)
+    {
+        if(found[r]) hle[entries[r]]={(HleRoutine)r, bodies[r]};
+    }
+    return (unsigned)hle.size();
+}
+
+// Does what the routine would and returns to the caller. Declines, leaving
+// the guest code to run, when the native version could differ from it.
+bool Machine::runHle(const HleEntry &entry)
+{
+    switch(entry.routine)
+    {
+        case HLE_PRINTSTR:
+            return hlePrintstr();
+        case HLE_GETCHAR:
+            return hleGetchar(entry.body);
+        case HLE_PRINTINT:
+            return hlePrintint(entry.body);
+        default:
+            return false;
+    }
+}
+
+// pop pc, which also sets the flags from the return address
+bool Machine::hleReturn()
+{
+    uint16_t address;
+    if(!pop(address)) return false;
+    registers[PC_REGISTER]=address;
+    z(address==0);
+    n((int16_t)address<0);
+    c(false);
+    v(false);
+    return true;
+}
+
+// r0 ends on the terminating zero, r1 and r2 are saved by the routine
+bool Machine::hlePrintstr()
+{
+    uint16_t screen;
+    if(!memory.read(hleScreen, screen) || screen!=SCREEN_OUT) return false;
+    std::vector<uint16_t> text;
+    uint16_t address=registers[0];
+    uint16_t value;
+    while(true)
+    {
+        if(text.size()>=MEMORY_SIZE/WORD_SIZE || !memory.read(address, value)) return false;
+        if(value==0) break;
+        text.push_back(value);
+        address+=WORD_SIZE;
+    }
+    for(auto chr:text)
+    {
+        putScreen(chr);
+    }
+    output->flush();
+    registers[0]=address;
+    return hleReturn();
+}
+
+// Waiting for a key is left to the guest, only a pending key is taken natively
+bool Machine::hleGetchar(const HleBody &body)
+{
+    uint16_t present;
+    uint16_t hold;
+    uint16_t screen;
+    if(!memory.read(body.instructions[0].getSecondWord(), present) || present==0) return false;
+    if(!memory.read(body.instructions[4].getSecondWord(), hold)) return false;
+    if(!memory.read(body.instructions[5].getSecondWord(), screen)) return false;
+    if(!memWrite(body.instructions[3].getSecondWord(), 0)) return false;
+    registers[0]=hold;
+    registers[2]=screen;
+    if(!memWrite(screen, hold)) return false;
+    return hleReturn();
+}
+
+// Leaves the digits in printint_buff and the registers as the guest loop does.
+// -32768 makes the guest recurse forever, so it is left to the guest.
+bool Machine::hlePrintint(const HleBody &body)
+{
+    uint16_t screen;
+    auto number=(int16_t)registers[0];
+    if(number==INT16_MIN || !memory.read(hleScreen, screen) || screen!=SCREEN_OUT) return false;
+    uint16_t end=body.instructions[3].getSecondWord();
+    uint16_t cursor=end-WORD_SIZE;
+    if(!memWrite(cursor, 0)) return false;
+    std::string digits;
+    if(number==0)
+    {
+        cursor-=WORD_SIZE;
+        if(!memWrite(cursor, '0')) return false;
+        digits="0";
+    }
+    else
+    {
+        uint16_t value=number<0 ? -number : number;
+        while(value!=0)
+        {
+            cursor-=WORD_SIZE;
+            if(!memWrite(cursor, '0'+value%10)) return false;
+            digits.insert(digits.begin(), (char)('0'+value%10));
+            value/=10;
+        }
+        registers[2]=0;
+        registers[3]=(uint16_t)digits[0];
+    }
+    if(number<0) putScreen('-');
+    for(auto chr:digits)
+    {
+        putScreen(chr);
+    }
+    output->flush();
+    registers[0]=end-WORD_SIZE;
+    registers[1]=cursor;
+    return hleReturn();
+}
+
 bool Machine::fetch(Instruction &ins)
 {
     uint16_t first;
@@ -383,10 +648,90 @@ bool Machine::callExecutor(Machine &machine, Instruction &instruction)
 
 bool Machine::iretExecutor(Machine &machine, Instruction &instruction)
 {
+    if(instruction.isBlock()) return blockExecutor(machine, instruction);
+    if(instruction.isPacked()) return packedExecutor(machine, instruction);
     if(!machine.pop(machine.registers[PSW_REGISTER])) return false;
     return machine.pop(machine.registers[PC_REGISTER]);
 }
 
+// Does one chunk and steps PC back while bytes remain, so interrupts are taken
+// between chunks and the registers always describe the work left. A copy to a
+// higher overlapping address runs from the end and leaves R0 and R1 in place.
+bool Machine::blockExecutor(Machine &machine, Instruction &instruction)
+{
+    uint16_t &destination=machine.registers[0];
+    uint16_t &source=machine.registers[1];
+    uint16_t &count=machine.registers[2];
+    uint16_t length=std::min<uint16_t>(count, BLOCK_CHUNK_SIZE);
+    if(!machine.inRam(destination, count)) return false;
+    switch(instruction.getValue1())
+    {
+        case BLOCK_MOVE:
+            if(!machine.inRam(source, count)) return false;
+            if(destination>source && destination<source+count)
+            {
+                machine.memory.move(destination+count-length, source+count-length, length);
+            }
+            else
+            {
+                machine.memory.move(destination, source, length);
+                destination+=length;
+                source+=length;
+            }
+            break;
+        case BLOCK_FILL:
+            machine.memory.fill(destination, (uint8_t)source, length);
+            destination+=length;
+            break;
+        default:
+            return false;
+    }
+    count-=length;
+    if(count!=0) machine.registers[PC_REGISTER]-=WORD_SIZE;
+    return true;
+}
+
+// Both bytes of the register at once, flags as for and
+bool Machine::packedExecutor(Machine &machine, Instruction &instruction)
+{
+    unsigned source=instruction.getSecondWord()&((1u<<PACKED_OPERATION_SHIFT)-1);
+    uint16_t arg1=machine.registers[instruction.getValue1()];
+    uint16_t arg2=machine.registers[source];
+    uint16_t result=0;
+    for(unsigned shift=0;shift<16;shift+=8)
+    {
+        uint8_t a=arg1>>shift;
+        uint8_t b=arg2>>shift;
+        uint8_t byte;
+        switch(instruction.getSecondWord()>>PACKED_OPERATION_SHIFT)
+        {
+            case PACKED_ADD:
+                byte=a+b;
+                break;
+            case PACKED_SUB:
+                byte=a-b;
+                break;
+            case PACKED_CMPEQ:
+                byte=a==b ? 0xff : 0;
+                break;
+            case PACKED_MIN:
+                byte=std::min(a, b);
+                break;
+            case PACKED_MAX:
+                byte=std::max(a, b);
+                break;
+            case PACKED_SWAP:
+                byte=arg2>>(8-shift);
+                break;
+            default:
+                return false;
+        }
+        result|=byte<<shift;
+    }
+    return machine.storeResult(instruction.getType1(), instruction.getValue1(), instruction.getSecondWord(),
+                               (int16_t)result);
+}
+
 bool Machine::movExecutor(Machine &machine, Instruction &instruction)
 {
     int16_t arg2;
@@ -560,15 +905,165 @@ bool Machine::memWrite(uint16_t address, uint16_t value)
     {
         if(address==SCREEN_OUT)
         {
-            char chr=value;
-            if(value==16)
+            putScreen(value);
+            output->flush();
+        }
+        else if(address==HYPERCALL_ARGS)
+        {
+            return memory.write(address, value);
+        }
+        else if(address==HYPERCALL_PORT)
+        {
+            return hypercall(value);
+        }
+        return true;
+    }
+}
+
+void Machine::putScreen(uint16_t value)
+{
+    char chr=value;
+    if(value==16)
+    {
+        chr='\n';
+    }
+    *output<<chr;
+}
+
+bool Machine::hypercall(uint16_t service)
+{
+    std::lock_guard<std::recursive_mutex> lck(mtx);
+    uint16_t block;
+    uint16_t result;
+    if(!memory.read(HYPERCALL_ARGS, block)) return false;
+    if(!inRam(block, WORD_SIZE) || block%WORD_SIZE!=0 || !hypercallService(service, block+WORD_SIZE, result))
+    {
+        return memory.write(HYPERCALL_PORT, (uint16_t)HYPERCALL_FAILED);
+    }
+    memory.write(block, result);
+    return memory.write(HYPERCALL_PORT, (uint16_t)HYPERCALL_OK);
+}
+
+bool Machine::readWord(uint16_t address, uint16_t &value)
+{
+    return address%WORD_SIZE==0 && memory.read(address, value);
+}
+
+// Characters up to the terminating 0, end is where the 0 is
+bool Machine::readString(uint16_t address, std::vector<uint16_t> &text, uint16_t &end)
+{
+    uint16_t value;
+    text.clear();
+    while(true)
+    {
+        if(text.size()>=MEMORY_SIZE/WORD_SIZE || !readWord(address, value)) return false;
+        if(value==0) break;
+        text.push_back(value);
+        address+=WORD_SIZE;
+    }
+    end=address;
+    return true;
+}
+
+// Hypercalls only touch memory below the I/O segment
+bool Machine::inRam(uint16_t address, uint16_t length) const
+{
+    return (uint32_t)address+length<=IO_SEGMENT_START;
+}
+
+bool Machine::hypercallService(uint16_t service, uint16_t block, uint16_t &result)
+{
+    uint16_t args[2];
+    if(!readWord(block, args[0]) || !readWord(block+WORD_SIZE, args[1])) return false;
+    switch(service)
+    {
+        case HYPERCALL_MEMCPY:
+        case HYPERCALL_MEMSET:
+        {
+            uint16_t length;
+            if(!readWord(block+2*WORD_SIZE, length) || !inRam(args[0], length)) return false;
+            if(service==HYPERCALL_MEMSET) memory.fill(args[0], (uint8_t)args[1], length);
+            else if(!inRam(args[1], length)) return false;
+            else memory.move(args[0], args[1], length);
+            result=args[0];
+            return true;
+        }
+        case HYPERCALL_STRCMP:
+        {
+            std::vector<uint16_t> a;
+            std::vector<uint16_t> b;
+            uint16_t end;
+            if(!readString(args[0], a, end) || !readString(args[1], b, end)) return false;
+            if(a==b) result=0;
+            else result=std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end()) ? (uint16_t)-1 : 1;
+            return true;
+        }
+        case HYPERCALL_FORMAT_INT:
+        {
+            auto text=std::to_string((int16_t)args[0]);
+            if(!inRam(args[1], (uint16_t)((text.length()+1)*WORD_SIZE)) || args[1]%WORD_SIZE!=0) return false;
+            for(size_t i=0;i<=text.length();i++)
+            {
+                memory.write((uint16_t)(args[1]+i*WORD_SIZE), (uint16_t)(i<text.length() ? text[i] : 0));
+            }
+            result=(uint16_t)text.length();
+            return true;
+        }
+        case HYPERCALL_PARSE_INT:
+        {
+            uint16_t address=args[0];
+            uint16_t value;
+            bool negative=readWord(address, value) && value=='-';
+            if(negative) address+=WORD_SIZE;
+            result=0;
+            while(readWord(address, value) && value>='0' && value<='9')
             {
-                chr='\n';
+                result=(uint16_t)(result*10+value-'0');
+                address+=WORD_SIZE;
             }
-            std::cout<<chr;
-            std::cout.flush();
+            if(!inRam(block+WORD_SIZE, WORD_SIZE)) return false;
+            memory.write((uint16_t)(block+WORD_SIZE), address);
+            if(negative) result=-result;
+            return true;
         }
-        return true;
+        case HYPERCALL_WRITE:
+        {
+            std::vector<uint16_t> text;
+            uint16_t value;
+            if(args[1]==0)
+            {
+                uint16_t end;
+                if(!readString(args[0], text, end)) return false;
+            }
+            for(uint16_t i=0;i<args[1];i++)
+            {
+                if(!readWord((uint16_t)(args[0]+i*WORD_SIZE), value)) return false;
+                text.push_back(value);
+            }
+            for(auto chr:text)
+            {
+                putScreen(chr);
+            }
+            output->flush();
+            result=(uint16_t)text.size();
+            return true;
+        }
+        case HYPERCALL_READ:
+        {
+            uint16_t count=0;
+            if(args[0]%WORD_SIZE!=0) return false;
+            while(count<args[1] && !pendingInput.empty())
+            {
+                if(!inRam((uint16_t)(args[0]+count*WORD_SIZE), WORD_SIZE)) break;
+                memory.write((uint16_t)(args[0]+count*WORD_SIZE), (uint16_t)pendingInput.front());
+                pendingInput.pop_front();
+                count++;
+            }
+            result=count;
+            return true;
+        }
+        default:
+            return false;
     }
 }
 
@@ -580,14 +1075,21 @@ void Machine::inputReader(Machine *machine)
         {
             if(val==EOF) break;
             machine->mtx.lock();
-            while (!machine->memory.isKbdInOk() || !machine->notifyInterrupt(3))
+            machine->pendingInput.push_back((uint8_t)val);
+            // A read hypercall may take the character before the interrupt does
+            while (!machine->pendingInput.empty() &&
+                   (!machine->memory.isKbdInOk() || !machine->notifyInterrupt(3)))
             {
                 machine->mtx.unlock();
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 machine->mtx.lock();
             }
-            machine->memory.setKbdInOk(false);
-            machine->memory.write(KBD_IN, (uint8_t)val);
+            if(!machine->pendingInput.empty())
+            {
+                machine->memory.setKbdInOk(false);
+                machine->memory.write(KBD_IN, machine->pendingInput.front());
+                machine->pendingInput.pop_front();
+            }
             machine->mtx.unlock();
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
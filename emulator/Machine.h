@@ -7,12 +7,24 @@
 
 
 #include <mutex>
+#include <functional>
 #include <cstdint>
+#include <ostream>
+#include <string>
+#include <deque>
 #include <unordered_map>
+#include <vector>
 #include <semaphore.h>
 #include "Memory.h"
 #include "../common/machine_params.h"
 #include "Instruction.h"
+#include "../common/Image.h"
+#include "Hle.h"
+#include "Hypercall.h"
+
+// Instruction counts standing in for the keyboard and timer delays of run()
+#define HEADLESS_INPUT_STEPS 20000
+#define HEADLESS_TIMER_STEPS 1000000
 
 class Machine
 {
@@ -20,8 +32,26 @@ public:
     Machine();
     bool setRegister(uint16_t reg, uint16_t val);
     bool getRegister(uint16_t reg, uint16_t &val);
+    bool load(const Image &image);
     bool step();
     bool run();
+    // Runs without a terminal or threads. Keyboard input comes from input and
+    // time is counted in instructions. Gives up after maxSteps instructions
+    // unless it is 0.
+    bool runHeadless(const std::string &input, uint64_t maxSteps=0);
+    void setOutput(std::ostream &output);
+    uint64_t getSteps() const;
+    // Writes the address and source line of every executed instruction, nullptr stops tracing
+    void setTrace(std::ostream *trace);
+    // Counts executed instructions per address
+    void setProfile(bool profile);
+    // Instruction counts per source line, hottest first
+    void writeProfile(std::ostream &stream) const;
+    // Instructions executed at each address, empty unless profiling
+    const std::vector<uint64_t> &getProfile() const;
+    // Runs the stdlib routines of Hle.h natively where the loaded image has
+    // unmodified copies of them. Returns how many routines were taken over.
+    unsigned enableHle(const Image &image);
 
     Memory &getMemory();
 
@@ -37,6 +67,32 @@ protected:
     bool interrupt(int id);
     bool memWrite(uint16_t address, uint16_t value);
     volatile bool running;
+    std::ostream *output;
+    uint64_t steps;
+    LineTable lines;
+    std::ostream *trace;
+    std::vector<uint64_t> profile;
+    struct HleEntry
+    {
+        HleRoutine routine;
+        HleBody body;
+    };
+    std::unordered_map<uint16_t, HleEntry> hle;
+    // Word printstr takes the screen address from
+    uint16_t hleScreen;
+    bool runHle(const HleEntry &entry);
+    bool hlePrintstr();
+    bool hleGetchar(const HleBody &body);
+    bool hlePrintint(const HleBody &body);
+    bool hleReturn();
+    void putScreen(uint16_t value);
+    // Keyboard input not yet given to the guest
+    std::deque<uint8_t> pendingInput;
+    bool hypercall(uint16_t service);
+    bool hypercallService(uint16_t service, uint16_t block, uint16_t &result);
+    bool readWord(uint16_t address, uint16_t &value);
+    bool readString(uint16_t address, std::vector<uint16_t> &text, uint16_t &end);
+    bool inRam(uint16_t address, uint16_t length) const;
     bool interruptSignals[16];
     bool notifyInterrupt(int id);
     void handleInterrupts();
@@ -72,6 +128,8 @@ protected:
     static bool popExecutor(Machine &machine, Instruction &instruction);
     static bool callExecutor(Machine &machine, Instruction &instruction);
     static bool iretExecutor(Machine &machine, Instruction &instruction);
+    static bool blockExecutor(Machine &machine, Instruction &instruction);
+    static bool packedExecutor(Machine &machine, Instruction &instruction);
     static bool movExecutor(Machine &machine, Instruction &instruction);
     static bool shlExecutor(Machine &machine, Instruction &instruction);
     static bool shrExecutor(Machine &machine, Instruction &instruction);
@@ -35,6 +35,12 @@ bool Memory::read(uint16_t address, uint16_t &data)
     return true;
 }
 
+bool Memory::read(uint16_t address, uint8_t &data)
+{
+    data=memory[address];
+    return true;
+}
+
 bool Memory::blkwrite(uint16_t start, uint16_t end, const std::vector<uint8_t> &data)
 {
     if(start>end) return false;
@@ -42,6 +48,30 @@ bool Memory::blkwrite(uint16_t start, uint16_t end, const std::vector<uint8_t> &
     return false;
 }
 
+bool Memory::blkwrite(uint16_t start, const uint8_t *data, uint16_t length)
+{
+    if((uint32_t)start+length>MEMORY_SIZE) return false;
+    memcpy(memory.data()+start, data, length);
+    return true;
+}
+
+// Ranges may overlap
+bool Memory::move(uint16_t destination, uint16_t source, uint16_t length)
+{
+    if((uint32_t)destination+length>MEMORY_SIZE || (uint32_t)source+length>MEMORY_SIZE) return false;
+    memmove(memory.data()+destination, memory.data()+source, length);
+    kbdInOk=true;
+    return true;
+}
+
+bool Memory::fill(uint16_t destination, uint8_t value, uint16_t length)
+{
+    if((uint32_t)destination+length>MEMORY_SIZE) return false;
+    memset(memory.data()+destination, value, length);
+    kbdInOk=true;
+    return true;
+}
+
 volatile bool Memory::isKbdInOk() const
 {
     return kbdInOk;
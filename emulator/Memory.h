@@ -17,7 +17,11 @@ public:
     bool write(uint16_t address, uint16_t data);
 
     bool read(uint16_t address, uint16_t &data);
+    bool read(uint16_t address, uint8_t &data);
     bool blkwrite(uint16_t start, uint16_t end, const std::vector<uint8_t> &data);
+    bool blkwrite(uint16_t start, const uint8_t *data, uint16_t length);
+    bool move(uint16_t destination, uint16_t source, uint16_t length);
+    bool fill(uint16_t destination, uint8_t value, uint16_t length);
 
     volatile bool isKbdInOk() const;
 
@@ -0,0 +1,102 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "generator/Generator.h"
+
+bool readCount(const char *arg, unsigned &value)
+{
+    auto number=atoi(arg);
+    if(number<0)
+    {
+        std::cerr<<"Invalid count "<<arg<<"\n";
+        return false;
+    }
+    value=(unsigned)number;
+    return true;
+}
+
+bool getArgs(int argc, char **argv, Generator::Options &options, std::string &outdir)
+{
+    int opt;
+    while((opt=getopt(argc, argv, "m:n:g:t:w:r:d:"))!=-1)
+    {
+        if(opt=='?')
+        {
+            std::cerr<< "Format "<<argv[0]<<" [-m MODULES][-n LINES][-g GLOBALS][-t TABLES][-w TABLE_SIZE][-r SEED][-d OUTPUT_DIR]\n";
+            std::cerr<<"Arguments:\n-m MODULES (optional, default 1, more than one needs -d)";
+            std::cerr<<"\n-n LINES (optional, default 1000, instructions per module)";
+            std::cerr<<"\n-g GLOBALS (optional, default 16, exported symbols per module)";
+            std::cerr<<"\n-t TABLES (optional, default 4, .word tables per module)\n-w TABLE_SIZE (optional, default 16)";
+            std::cerr<<"\n-r SEED (optional, default 1)";
+            std::cerr<<"\n-d OUTPUT_DIR (optional, writes OUTPUT_DIR/modN.s, otherwise the module goes to standard output)";
+            return false;
+        }
+        bool ok=true;
+        switch(opt)
+        {
+            case 'm':
+                ok=readCount(optarg, options.modules);
+                break;
+            case 'n':
+                ok=readCount(optarg, options.lines);
+                break;
+            case 'g':
+                ok=readCount(optarg, options.globals);
+                break;
+            case 't':
+                ok=readCount(optarg, options.tables);
+                break;
+            case 'w':
+                ok=readCount(optarg, options.tableSize);
+                break;
+            case 'r':
+                options.seed=(uint32_t)strtoul(optarg, nullptr, 10);
+                break;
+            case 'd':
+                outdir=optarg;
+                break;
+            default:
+                break;
+        }
+        if(!ok) return false;
+    }
+    if(options.modules>1 && outdir.empty())
+    {
+        std::cerr<<"Several modules need an output directory\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Generator::Options options;
+    std::string outdir;
+    if(!getArgs(argc, argv, options, outdir))
+    {
+        return -1;
+    }
+    Generator generator(options);
+    if(outdir.empty())
+    {
+        std::cout<<generator.module(0);
+        return 0;
+    }
+    for(unsigned i=0;i<generator.getOptions().modules;i++)
+    {
+        auto fileName=outdir+"/mod"+std::to_string(i)+".s";
+        std::ofstream ofs(fileName);
+        if(ofs.fail())
+        {
+            std::cerr<<"Failed to open output file "<<fileName<<"\n";
+            return -1;
+        }
+        ofs<<generator.module(i);
+    }
+    return 0;
+}
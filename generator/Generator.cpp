@@ -0,0 +1,131 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include "Generator.h"
+
+#define LABEL_SPACING 8
+#define INSTRUCTION_KINDS 8
+
+static std::string symbolName(unsigned module, const char *kind, unsigned index)
+{
+    return "m"+std::to_string(module)+"_"+kind+std::to_string(index);
+}
+
+Generator::Generator(const Options &options)
+:options(options)
+{
+    if(Generator::options.modules==0) Generator::options.modules=1;
+}
+
+std::string Generator::module(unsigned index) const
+{
+    std::mt19937 random(options.seed*7919u+index);
+    std::ostringstream out;
+    unsigned next=(index+1)%options.modules;
+    bool imports=options.modules>1;
+    unsigned labels=(options.lines+LABEL_SPACING-1)/LABEL_SPACING;
+    unsigned globalSpacing=options.globals==0 ? 0 : options.lines/options.globals+1;
+    if(index==0) out<<".global START\n";
+    for(unsigned k=0;k<options.globals;k++)
+    {
+        out<<".global "<<symbolName(index, "g", k)<<"\n";
+        if(imports) out<<".global "<<symbolName(next, "g", k)<<"\n";
+    }
+    out<<".text\n";
+    if(index==0) out<<"START:\n";
+    unsigned placedGlobals=0;
+    for(unsigned n=0;n<options.lines;n++)
+    {
+        if(globalSpacing!=0 && n%globalSpacing==0 && placedGlobals<options.globals)
+        {
+            out<<symbolName(index, "g", placedGlobals++)<<":\n";
+        }
+        unsigned current=n/LABEL_SPACING;
+        if(n%LABEL_SPACING==0) out<<"l"<<current<<":";
+        unsigned r1=random()%6;
+        unsigned r2=random()%6;
+        // A table load without tables becomes a call, a call without globals an indexed mov
+        auto emitCall=[&]()
+        {
+            out<<"    call "<<symbolName(imports ? next : index, "g", random()%options.globals)<<"\n";
+        };
+        auto emitIndexed=[&]()
+        {
+            out<<"    mov r"<<r1<<", r"<<r2<<"[4]\n";
+        };
+        switch(random()%INSTRUCTION_KINDS)
+        {
+            case 0:
+                out<<"    mov r"<<r1<<", "<<random()%1000<<"\n";
+                break;
+            case 1:
+                out<<"    add r"<<r1<<", r"<<r2<<"\n";
+                break;
+            case 2:
+                out<<"    cmp r"<<r1<<", "<<random()%100<<"\n";
+                break;
+            case 3:
+            {
+                unsigned target=current+1+random()%4;
+                out<<"    jmpeq $l"<<(target<labels ? target : labels-1)<<"\n";
+                break;
+            }
+            case 4:
+                out<<"    jmpne $l"<<current-std::min(current, (unsigned)(random()%4))<<"\n";
+                break;
+            case 5:
+                if(options.tables!=0)
+                {
+                    out<<"    mov r"<<r1<<", &"<<symbolName(index, "t", random()%options.tables)<<"\n";
+                }
+                else if(options.globals!=0)
+                {
+                    emitCall();
+                }
+                else
+                {
+                    emitIndexed();
+                }
+                break;
+            case 6:
+                if(options.globals!=0)
+                {
+                    emitCall();
+                }
+                else
+                {
+                    emitIndexed();
+                }
+                break;
+            default:
+                emitIndexed();
+                break;
+        }
+    }
+    for(;placedGlobals<options.globals;placedGlobals++)
+    {
+        out<<symbolName(index, "g", placedGlobals)<<":\n";
+    }
+    out<<"    ret\n";
+    out<<".data\n";
+    for(unsigned t=0;t<options.tables;t++)
+    {
+        out<<symbolName(index, "t", t)<<":\n";
+        for(unsigned w=0;w<options.tableSize;w++)
+        {
+            if(w%2==0 && labels!=0) out<<".word l"<<random()%labels<<"\n";
+            else out<<".word "<<random()%65536<<"\n";
+        }
+    }
+    out<<".end\n";
+    return out.str();
+}
+
+const Generator::Options &Generator::getOptions() const
+{
+    return options;
+}
@@ -0,0 +1,39 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_GENERATOR_H
+#define SS_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+// Writes valid synthetic programs for benchmarking the toolchain. Module i
+// exports globals mI_gK, calls the globals of module i+1, jumps forward and
+// back between local labels and keeps .word tables of labels and numbers in
+// .data. Module 0 also defines START. Output depends only on the options.
+class Generator
+{
+public:
+    struct Options
+    {
+        unsigned modules=1;
+        unsigned lines=1000;
+        unsigned globals=16;
+        unsigned tables=4;
+        unsigned tableSize=16;
+        uint32_t seed=1;
+    };
+
+    explicit Generator(const Options &options);
+
+    std::string module(unsigned index) const;
+
+    const Options &getOptions() const;
+
+protected:
+    Options options;
+};
+
+
+#endif //SS_GENERATOR_H
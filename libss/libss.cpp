@@ -0,0 +1,77 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <sstream>
+#include "libss.h"
+#include "../assembler/File.h"
+#include "../assembler/Assembler.h"
+#include "../assembler/Optimizer.h"
+#include "../linker/Linker.h"
+
+bool ss::assemble(const std::string &source, ObjectFile &object, std::vector<std::string> &errors,
+                  std::vector<std::string> &warnings, const AssembleOptions &options, const std::string &name)
+{
+    std::istringstream input(source);
+    File file(input, name);
+    if(!file.isValid())
+    {
+        errors.insert(errors.end(), file.getErrors().begin(), file.getErrors().end());
+        return false;
+    }
+    Assembler as(file, options.startAddress);
+    as.setFragments(options.fragments);
+    as.setShortEncodings(options.shortEncodings);
+    as.setLineTable(options.lineTable);
+    Optimizer optimizer;
+    if(options.optimize)
+    {
+        if(optimizer.optimize(file.getLines())) as.setLines(optimizer.getLines());
+        warnings.insert(warnings.end(), optimizer.getWarnings().begin(), optimizer.getWarnings().end());
+    }
+    if(!(options.singlePass ? as.singlePass() : as.firstPass() && as.secondPass()))
+    {
+        errors.insert(errors.end(), as.getErrors().begin(), as.getErrors().end());
+        return false;
+    }
+    warnings.insert(warnings.end(), as.getWarnings().begin(), as.getWarnings().end());
+    std::stringstream buffer;
+    as.outputObject(buffer, true);
+    object=ObjectFile(buffer, name);
+    if(!object.isValid())
+    {
+        errors.push_back("Assembled object "+name+" is invalid");
+        return false;
+    }
+    return true;
+}
+
+bool ss::link(std::vector<ObjectFile> objects, Image &image, std::vector<std::string> &errors,
+              const LinkOptions &options)
+{
+    Linker linker(1);
+    linker.setAutoPlace(options.autoPlace);
+    linker.setCollectGarbage(options.collectGarbage);
+    bool added=true;
+    for(auto &object:objects)
+    {
+        added=linker.addObject(std::move(object)) && added;
+    }
+    if(!added || !linker.link())
+    {
+        errors.insert(errors.end(), linker.getErrors().begin(), linker.getErrors().end());
+        return false;
+    }
+    image=linker.getImage();
+    return true;
+}
+
+bool ss::run(const Image &image, const std::string &input, std::string &output, uint64_t maxSteps)
+{
+    Machine machine;
+    std::ostringstream screen;
+    machine.setOutput(screen);
+    bool result=machine.load(image) && machine.runHeadless(input, maxSteps);
+    output=screen.str();
+    return result;
+}
@@ -0,0 +1,50 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_LIBSS_H
+#define SS_LIBSS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../linker/ObjectFile.h"
+#include "../common/Image.h"
+#include "../emulator/Machine.h"
+
+// ssas, sslink and ssemu as calls, for harnesses that assemble, link and run
+// many small programs. Nothing touches the file system.
+namespace ss
+{
+    struct AssembleOptions
+    {
+        uint16_t startAddress=WORD_SIZE*IVT_SIZE;
+        bool fragments=false;
+        bool optimize=false;
+        bool shortEncodings=false;
+        bool lineTable=false;
+        bool singlePass=false;
+    };
+
+    struct LinkOptions
+    {
+        bool autoPlace=false;
+        bool collectGarbage=false;
+    };
+
+    // warnings gets what ssas prints besides errors: the optimizer's warnings, and
+    // the assembler's when assembly succeeds
+    bool assemble(const std::string &source, ObjectFile &object, std::vector<std::string> &errors,
+                  std::vector<std::string> &warnings, const AssembleOptions &options=AssembleOptions(),
+                  const std::string &name="source");
+
+    bool link(std::vector<ObjectFile> objects, Image &image, std::vector<std::string> &errors,
+              const LinkOptions &options=LinkOptions());
+
+    // Loads the image into a fresh machine and runs it headless, output gets what
+    // the program writes to the screen
+    bool run(const Image &image, const std::string &input, std::string &output, uint64_t maxSteps=0);
+}
+
+
+#endif //SS_LIBSS_H
@@ -0,0 +1,118 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <getopt.h>
+#include "linker/Linker.h"
+
+bool getArgs(int argc, char **argv, std::string &outfile, std::string &mapfile, bool &autoPlace,
+             uint16_t &alignment, bool &gc, std::vector<std::string> &infiles)
+{
+    static const option longOptions[]={{"gc", no_argument, nullptr, 'g'}, {nullptr, 0, nullptr, 0}};
+    int opt;
+    while((opt=getopt_long(argc, argv, "o:m:pa:g", longOptions, nullptr))!=-1)
+    {
+        if(opt=='?')
+        {
+            std::cerr<< "Format "<<argv[0]<<" [-o OUTPUT_FILE][-m MAP_FILE][-p][-a ALIGNMENT][--gc] input_files...\n";
+            std::cerr<<"Arguments:\n-o OUTPUT_FILE_NAME (optional, default a.out)\n-m MAP_FILE_NAME (optional, writes memory layout and symbol map)";
+            std::cerr<<"\n-p (optional, place objects automatically after the IV table)\n-a ALIGNMENT (optional, default 2)";
+            std::cerr<<"\n-g, --gc (optional, drop code and data unreachable from START and the IV table)";
+            return false;
+        }
+        switch(opt)
+        {
+            case 'g':
+                gc=true;
+                break;
+            case 'p':
+                autoPlace=true;
+                break;
+            case 'a':
+            {
+                auto align=atoi(optarg);
+                if(align<=0 || align>=MAX_PROGRAM_SIZE)
+                {
+                    std::cerr<<"Invalid alignment "<<optarg<<"\n";
+                    return false;
+                }
+                alignment=(uint16_t)align;
+                break;
+            }
+            case 'o':
+                outfile=optarg;
+                break;
+            case 'm':
+                mapfile=optarg;
+                break;
+            default:
+                break;
+        }
+    }
+    if(argc<=optind)
+    {
+        std::cerr<<"No input files given\n";
+        return false;
+    }
+    for(int i=optind;i<argc;i++)
+    {
+        infiles.push_back(argv[i]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outfile="a.out";
+    std::string mapfile;
+    bool autoPlace=false;
+    uint16_t alignment=WORD_SIZE;
+    bool gc=false;
+    std::vector<std::string> infiles;
+    if(!getArgs(argc, argv, outfile, mapfile, autoPlace, alignment, gc, infiles))
+    {
+        return -1;
+    }
+    Linker linker;
+    linker.setAutoPlace(autoPlace, alignment);
+    linker.setCollectGarbage(gc);
+    if(!linker.addFiles(infiles) || !linker.link())
+    {
+        for(const auto &error:linker.getErrors())
+        {
+            std::cerr<<error<<"\n";
+        }
+        std::cerr<<"Link failed\n";
+        return -1;
+    }
+    auto image=linker.getImage();
+    std::string reason;
+    if(!image.isWritable(reason))
+    {
+        std::cerr<<reason<<"\n";
+        std::cerr<<"Link failed\n";
+        return -1;
+    }
+    if(!image.write(outfile))
+    {
+        std::cerr<<"Failed to write output file "<<outfile<<"\n";
+        return -1;
+    }
+    if(!mapfile.empty())
+    {
+        std::ofstream ofs(mapfile, std::ios_base::out);
+        if(ofs.fail())
+        {
+            std::cerr<<"Failed to open map file "<<mapfile<<"\n";
+            return -1;
+        }
+        image.writeMap(ofs);
+    }
+    std::cerr<<"Link successful\n";
+    return 0;
+}
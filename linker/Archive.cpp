@@ -0,0 +1,161 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "Archive.h"
+#include "../common/StringTable.h"
+
+Archive::Archive()
+:valid(true)
+{
+
+}
+
+Archive::Archive(std::istream &inputStream, const std::string &fileName)
+:valid(false), name(fileName)
+{
+    if(inputStream.fail()) return;
+    std::string line;
+    std::getline(inputStream, line);
+    ObjectFile::trim(line);
+    if(line!="ARCHIVE:") return;
+    std::getline(inputStream, line);
+    ObjectFile::trim(line);
+    if(line!="INDEX:") return;
+    std::getline(inputStream, line);
+    std::vector<std::pair<std::string, size_t> > entries;
+    while(true)
+    {
+        if(inputStream.eof()) return;
+        std::getline(inputStream, line);
+        ObjectFile::trim(line);
+        if(line=="MEMBERS:") break;
+        std::istringstream entry(line);
+        std::string symbol;
+        size_t member;
+        if(!(entry>>symbol>>member)) return;
+        entries.push_back({symbol, member});
+    }
+    while(std::getline(inputStream, line))
+    {
+        ObjectFile::trim(line);
+        if(line.empty()) continue;
+        if(line.find("MEMBER: ")!=0) return;
+        std::istringstream header(line.substr(8));
+        Member member;
+        size_t size;
+        if(!(header>>member.name>>size)) return;
+        member.contents.resize(size);
+        if(!inputStream.read(&member.contents[0], size)) return;
+        members.push_back(std::move(member));
+    }
+    for(auto &entry:entries)
+    {
+        if(entry.second>=members.size()) return;
+        index[StringTable::intern(entry.first)]=entry.second;
+    }
+    valid=true;
+}
+
+bool Archive::isArchive(const std::string &fileName)
+{
+    std::ifstream ifs(fileName);
+    std::string line;
+    std::getline(ifs, line);
+    ObjectFile::trim(line);
+    return line=="ARCHIVE:";
+}
+
+bool Archive::addMember(const std::string &memberName, const std::string &contents)
+{
+    std::istringstream iss(contents);
+    ObjectFile file(iss, memberName);
+    if(!file.isValid())
+    {
+        errors.push_back("File "+memberName+" is invalid");
+        return false;
+    }
+    std::vector<uint32_t> defined;
+    for(auto &symbolPair:file.getSymbols())
+    {
+        if(!symbolPair.second.isGlobal() ||
+           symbolPair.second.getSectionId()==StringTable::UNKNOWN) continue;
+        if(index.count(symbolPair.first))
+        {
+            errors.push_back("Duplicate definition of "+symbolPair.second.getName()+" in "+
+                             members[index[symbolPair.first]].name+" and "+memberName);
+            return false;
+        }
+        defined.push_back(symbolPair.first);
+    }
+    for(auto symbol:defined)
+    {
+        index[symbol]=members.size();
+    }
+    members.push_back({memberName, contents});
+    return true;
+}
+
+void Archive::write(std::ostream &stream) const
+{
+    std::vector<std::pair<std::string, size_t> > entries;
+    for(auto &entry:index)
+    {
+        entries.push_back({StringTable::lookup(entry.first), entry.second});
+    }
+    std::sort(entries.begin(), entries.end());
+    auto flags=stream.flags();
+    stream<<"ARCHIVE:\n";
+    stream<<"INDEX:\n";
+    stream<<"Name            Member\n";
+    for(auto &entry:entries)
+    {
+        stream<<std::setw(16)<<std::left<<entry.first;
+        stream<<entry.second<<"\n";
+    }
+    stream<<"MEMBERS:\n";
+    for(auto &member:members)
+    {
+        stream<<"MEMBER: "<<member.name<<" "<<member.contents.size()<<"\n";
+        stream<<member.contents<<"\n";
+    }
+    stream.flags(flags);
+}
+
+bool Archive::findMember(uint32_t symbol, size_t &member) const
+{
+    auto iter=index.find(symbol);
+    if(iter==index.end()) return false;
+    member=iter->second;
+    return true;
+}
+
+ObjectFile Archive::loadMember(size_t member) const
+{
+    std::istringstream iss(members[member].contents);
+    return ObjectFile(iss, name+"("+members[member].name+")");
+}
+
+bool Archive::isValid() const
+{
+    return valid;
+}
+
+const std::string &Archive::getName() const
+{
+    return name;
+}
+
+const std::vector<Archive::Member> &Archive::getMembers() const
+{
+    return members;
+}
+
+const std::vector<std::string> &Archive::getErrors() const
+{
+    return errors;
+}
@@ -0,0 +1,53 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_ARCHIVE_H
+#define SS_ARCHIVE_H
+
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ObjectFile.h"
+
+// A library of object files with an index of the global symbols each of
+// them defines, so the linker only has to parse the members it needs.
+class Archive
+{
+public:
+    struct Member
+    {
+        std::string name;
+        std::string contents;
+    };
+
+    Archive();
+    Archive(std::istream &inputStream, const std::string &fileName);
+    static bool isArchive(const std::string &fileName);
+
+    bool addMember(const std::string &memberName, const std::string &contents);
+    void write(std::ostream &stream) const;
+    bool findMember(uint32_t symbol, size_t &member) const;
+    ObjectFile loadMember(size_t member) const;
+
+protected:
+    bool valid;
+    std::string name;
+    std::vector<Member> members;
+    std::unordered_map<uint32_t, size_t> index;
+    std::vector<std::string> errors;
+public:
+    bool isValid() const;
+
+    const std::string &getName() const;
+
+    const std::vector<Member> &getMembers() const;
+
+    const std::vector<std::string> &getErrors() const;
+};
+
+
+#endif //SS_ARCHIVE_H
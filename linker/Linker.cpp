@@ -0,0 +1,399 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include "Linker.h"
+#include "../common/StringTable.h"
+
+Linker::Linker(unsigned threads)
+:entry(0), autoPlace(false), gc(false), alignment(WORD_SIZE), pool(threads)
+{
+
+}
+
+void Linker::setCollectGarbage(bool collectGarbage)
+{
+    gc=collectGarbage;
+}
+
+void Linker::setAutoPlace(bool autoPlace, uint16_t alignment)
+{
+    Linker::autoPlace=autoPlace;
+    Linker::alignment=alignment==0 ? (uint16_t)1 : alignment;
+}
+
+bool Linker::addFile(const std::string &fileName)
+{
+    return addFiles({fileName});
+}
+
+bool Linker::addObject(ObjectFile object)
+{
+    if(!object.isValid())
+    {
+        emmitError("File "+object.getName()+" is invalid");
+        return false;
+    }
+    files.push_back(std::move(object));
+    return true;
+}
+
+bool Linker::addFiles(const std::vector<std::string> &fileNames)
+{
+    bool ok=true;
+    std::vector<std::string> objectNames;
+    for(auto &fileName:fileNames)
+    {
+        if(!Archive::isArchive(fileName))
+        {
+            objectNames.push_back(fileName);
+            continue;
+        }
+        std::ifstream ifs(fileName);
+        Archive archive(ifs, fileName);
+        if(!archive.isValid())
+        {
+            emmitError("Archive "+fileName+" is invalid");
+            ok=false;
+            continue;
+        }
+        archives.push_back(std::move(archive));
+    }
+    std::vector<std::unique_ptr<ObjectFile> > loaded(objectNames.size());
+    pool.run(objectNames.size(), [&objectNames, &loaded](size_t i)
+    {
+        std::ifstream ifs(objectNames[i]);
+        loaded[i].reset(new ObjectFile(ifs, objectNames[i]));
+    });
+    for(auto &f:loaded)
+    {
+        if(!f->isValid())
+        {
+            emmitError("File "+f->getName()+" is invalid");
+            ok=false;
+            continue;
+        }
+        files.push_back(std::move(*f));
+    }
+    return ok;
+}
+
+bool Linker::resolveArchives()
+{
+    std::vector<std::vector<char> > pulled;
+    for(auto &archive:archives)
+    {
+        pulled.emplace_back(archive.getMembers().size(), false);
+    }
+    while(true)
+    {
+        std::unordered_map<uint32_t, bool> defined;
+        for(auto &file:files)
+        {
+            for(auto &symbolPair:file.getSymbols())
+            {
+                if(!symbolPair.second.isGlobal()) continue;
+                bool isDefined=symbolPair.second.getSectionId()!=StringTable::UNKNOWN;
+                defined[symbolPair.first]|=isDefined;
+            }
+        }
+        defined[StringTable::intern("START")]|=false;
+        std::vector<std::string> undefined;
+        for(auto &symbol:defined)
+        {
+            if(!symbol.second) undefined.push_back(StringTable::lookup(symbol.first));
+        }
+        std::sort(undefined.begin(), undefined.end());
+        std::vector<std::pair<size_t, size_t> > members;
+        for(auto &name:undefined)
+        {
+            auto id=StringTable::intern(name);
+            for(size_t i=0;i<archives.size();i++)
+            {
+                size_t member;
+                if(!archives[i].findMember(id, member)) continue;
+                if(!pulled[i][member])
+                {
+                    pulled[i][member]=true;
+                    members.push_back({i, member});
+                }
+                break;
+            }
+        }
+        if(members.empty()) return true;
+        std::vector<std::unique_ptr<ObjectFile> > loaded(members.size());
+        pool.run(members.size(), [this, &members, &loaded](size_t i)
+        {
+            loaded[i].reset(new ObjectFile(archives[members[i].first].loadMember(members[i].second)));
+        });
+        for(auto &f:loaded)
+        {
+            if(!f->isValid())
+            {
+                emmitError("File "+f->getName()+" is invalid");
+                return false;
+            }
+            files.push_back(std::move(*f));
+        }
+    }
+}
+
+bool Linker::link()
+{
+    if(!resolveArchives()) return false;
+    if(gc) collectGarbage();
+    std::stable_sort(files.begin(), files.end(), [](const ObjectFile &x1, const ObjectFile &x2)->bool{return x1.getStart()<x2.getStart();});
+    std::string prevName="";
+    uint16_t prevEnd=0;
+    for(auto& file:files)
+    {
+        if(autoPlace && !holdsIvt(file)) continue;
+        if(file.getStart()<prevEnd)
+        {
+            emmitError("Files "+prevName+" and "+file.getName()+" overlap");
+            return false;
+        }
+        prevName=file.getName();
+        prevEnd=file.getStart()+file.getLength();
+    }
+    deltas.assign(files.size(), 0);
+    if(autoPlace && !place()) return false;
+    globalSymbols.clear();
+    pool.run(files.size(), [this](size_t i)
+    {
+        for(auto &symbolPair:files[i].getSymbols())
+        {
+            if(symbolPair.second.isGlobal() &&
+               symbolPair.second.getSectionId()!=StringTable::UNKNOWN)
+            {
+                Symbol symbol=symbolPair.second;
+                symbol.setOffset(symbol.getOffset()+deltas[i]);
+                globalSymbols.insert(symbolPair.first, symbol, i);
+            }
+        }
+    });
+    auto duplicates=globalSymbols.getDuplicates();
+    if(!duplicates.empty())
+    {
+        for(auto &duplicate:duplicates)
+        {
+            emmitError("Duplicate definition of "+StringTable::lookup(duplicate.name)+" in "+files[duplicate.fileIndex].getName());
+        }
+        return false;
+    }
+    for(auto &file: files)
+    {
+        std::vector<std::string> unresolved;
+        for(auto &symbolPair:file.getSymbols())
+        {
+            if(symbolPair.second.isGlobal() &&
+               symbolPair.second.getSectionId()==StringTable::UNKNOWN &&
+               globalSymbols.find(symbolPair.first)==nullptr)
+            {
+                unresolved.push_back(symbolPair.second.getName());
+            }
+        }
+        std::sort(unresolved.begin(), unresolved.end());
+        for(auto &name:unresolved)
+        {
+            emmitError("Unresolved symbol "+name+" in "+file.getName());
+        }
+    }
+    if(!errors.empty()) return false;
+    auto start=globalSymbols.find("START");
+    if(start==nullptr)
+    {
+        emmitError("Missing symbol START");
+        return false;
+    }
+    std::vector<char> relocated(files.size());
+    pool.run(files.size(), [this, &relocated](size_t i)
+    {
+        relocated[i]=files[i].relocate(globalSymbols, deltas[i]);
+    });
+    for(size_t i=0;i<files.size();i++)
+    {
+        if(!relocated[i])
+        {
+            emmitError("File "+files[i].getName()+" is invalid");
+            return false;
+        }
+    }
+    entry=start->getOffset();
+    if(autoPlace)
+    {
+        std::stable_sort(files.begin(), files.end(), [](const ObjectFile &x1, const ObjectFile &x2)->bool{return x1.getStart()<x2.getStart();});
+    }
+    return true;
+}
+
+void Linker::collectGarbage()
+{
+    std::unordered_map<uint32_t, std::pair<size_t, size_t> > definitions;
+    for(size_t f=0;f<files.size();f++)
+    {
+        for(auto &symbolPair:files[f].getSymbols())
+        {
+            auto &symbol=symbolPair.second;
+            if(!symbol.isGlobal() || symbol.getSectionId()==StringTable::UNKNOWN) continue;
+            if(definitions.count(symbolPair.first)) continue;
+            definitions[symbolPair.first]={f, files[f].fragmentAt(symbol.getSectionId(), (uint16_t)symbol.getOffset())};
+        }
+    }
+    std::vector<std::vector<bool> > keep;
+    std::vector<std::pair<size_t, size_t> > work;
+    auto mark=[&keep, &work](size_t f, size_t fragment)
+    {
+        if(keep[f][fragment]) return;
+        keep[f][fragment]=true;
+        work.push_back({f, fragment});
+    };
+    for(size_t f=0;f<files.size();f++)
+    {
+        auto &fragments=files[f].getFragments();
+        keep.emplace_back(std::max<size_t>(fragments.size(), 1), false);
+    }
+    for(size_t f=0;f<files.size();f++)
+    {
+        auto &fragments=files[f].getFragments();
+        if(!holdsIvt(files[f])) continue;
+        if(fragments.empty())
+        {
+            mark(f, 0);
+            continue;
+        }
+        for(size_t i=0;i<fragments.size();i++)
+        {
+            if(fragments[i].start<WORD_SIZE*IVT_SIZE) mark(f, i);
+        }
+    }
+    auto start=definitions.find(StringTable::intern("START"));
+    if(start!=definitions.end()) mark(start->second.first, start->second.second);
+    // Every global a kept file declares must still resolve, used or not
+    std::vector<bool> imported(files.size(), false);
+    while(!work.empty())
+    {
+        auto node=work.back();
+        work.pop_back();
+        auto &file=files[node.first];
+        auto &fragments=file.getFragments();
+        if(!imported[node.first])
+        {
+            imported[node.first]=true;
+            for(auto &symbolPair:file.getSymbols())
+            {
+                if(!symbolPair.second.isGlobal() || symbolPair.second.getSectionId()!=StringTable::UNKNOWN) continue;
+                auto definition=definitions.find(symbolPair.first);
+                if(definition!=definitions.end()) mark(definition->second.first, definition->second.second);
+            }
+        }
+        if(!fragments.empty() && fragments[node.second].fallthrough)
+        {
+            auto next=file.fragmentAt(fragments[node.second].section,
+                                      fragments[node.second].start+fragments[node.second].length);
+            if(next!=node.second && fragments[next].start==fragments[node.second].start+fragments[node.second].length)
+            {
+                mark(node.first, next);
+            }
+        }
+        for(auto &entry:file.getRelocationEntries())
+        {
+            if(file.fragmentAt(entry.getSectionId(), entry.getOffset())!=node.second) continue;
+            if(file.isLocalTarget(entry))
+            {
+                mark(node.first, file.fragmentAt(entry.getTargetSymbolId(), file.targetAddress(entry)));
+            }
+            else
+            {
+                auto definition=definitions.find(entry.getTargetSymbolId());
+                if(definition!=definitions.end()) mark(definition->second.first, definition->second.second);
+            }
+        }
+    }
+    std::vector<ObjectFile> kept;
+    for(size_t f=0;f<files.size();f++)
+    {
+        if(std::find(keep[f].begin(), keep[f].end(), true)==keep[f].end()) continue;
+        if(!files[f].getFragments().empty()) files[f].compact(keep[f]);
+        kept.push_back(std::move(files[f]));
+    }
+    files=std::move(kept);
+}
+
+// Only an object assembled at 0 fills in the IV table, objects assembled at
+// ssas's default start just overlap it by accident and are moved
+bool Linker::holdsIvt(const ObjectFile &file)
+{
+    return file.getStart()==0 && file.getLength()>0;
+}
+
+bool Linker::place()
+{
+    std::vector<std::pair<uint32_t, uint32_t> > used;
+    for(auto &file:files)
+    {
+        if(holdsIvt(file))
+        {
+            used.push_back({file.getStart(), file.getStart()+file.getLength()});
+        }
+    }
+    uint32_t cursor=WORD_SIZE*IVT_SIZE;
+    for(size_t i=0;i<files.size();i++)
+    {
+        auto &file=files[i];
+        if(holdsIvt(file)) continue;
+        bool moved=true;
+        while(moved)
+        {
+            moved=false;
+            cursor=(cursor+alignment-1)/alignment*alignment;
+            for(auto &range:used)
+            {
+                if(cursor<range.second && cursor+file.getLength()>range.first)
+                {
+                    cursor=range.second;
+                    moved=true;
+                }
+            }
+        }
+        if(cursor+file.getLength()>MAX_PROGRAM_SIZE-STACK_RESERVE)
+        {
+            emmitError("Program too big to fit in memory, no room for "+file.getName());
+            return false;
+        }
+        deltas[i]=(int32_t)cursor-file.getStart();
+        used.push_back({cursor, cursor+file.getLength()});
+        cursor+=file.getLength();
+    }
+    return true;
+}
+
+Image Linker::getImage() const
+{
+    Image image;
+    image.setEntry(entry);
+    for(auto &file: files)
+    {
+        image.addSegment(file.getStart(), file.getCode());
+        for(auto &sourceLine:file.getSourceLines())
+        {
+            image.addLine(file.getSourceName(), sourceLine.address, sourceLine.line);
+        }
+    }
+    for(auto &symbolPair:globalSymbols.getSymbols())
+    {
+        image.addSymbol(symbolPair.second.getName(), symbolPair.second.getOffset());
+    }
+    return image;
+}
+
+const std::vector<std::string> &Linker::getErrors() const
+{
+    return errors;
+}
+
+void Linker::emmitError(const std::string &message)
+{
+    errors.push_back(message);
+}
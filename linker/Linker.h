@@ -0,0 +1,57 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_LINKER_H
+#define SS_LINKER_H
+
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include "ObjectFile.h"
+#include "Archive.h"
+#include "SymbolTable.h"
+#include "../common/ThreadPool.h"
+#include "../common/Symbol.h"
+#include "../common/Image.h"
+#include "../common/machine_params.h"
+
+// Bump whenever the same objects and options link to a different image
+#define LINKER_VERSION 1
+
+class Linker
+{
+public:
+    explicit Linker(unsigned threads=0);
+    bool addFile(const std::string &fileName);
+    bool addFiles(const std::vector<std::string> &fileNames);
+    bool addObject(ObjectFile object);
+    bool link();
+    void setAutoPlace(bool autoPlace, uint16_t alignment=WORD_SIZE);
+    void setCollectGarbage(bool collectGarbage);
+    Image getImage() const;
+
+    const std::vector<std::string> &getErrors() const;
+
+protected:
+    void emmitError(const std::string &message);
+    bool resolveArchives();
+    bool place();
+    void collectGarbage();
+    static bool holdsIvt(const ObjectFile &file);
+    std::vector<ObjectFile> files;
+    std::vector<Archive> archives;
+    SymbolTable globalSymbols;
+    std::vector<std::string> errors;
+    std::vector<int32_t> deltas;
+    uint16_t entry;
+    bool autoPlace;
+    bool gc;
+    uint16_t alignment;
+    ThreadPool pool;
+};
+
+
+#endif //SS_LINKER_H
@@ -0,0 +1,530 @@
+//
+// Created by nidzo on 20.5.18..
+//
+
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include "ObjectFile.h"
+
+ObjectFile::ObjectFile()
+:valid(false), start(0), length(0)
+{
+    std::fill(hasSection, hasSection+StringTable::SECTION_COUNT, false);
+}
+
+ObjectFile::ObjectFile(std::istream &inputStream, const std::string &fileName)
+{
+    valid=false;
+    name=fileName;
+    std::fill(hasSection, hasSection+StringTable::SECTION_COUNT, false);
+    if(inputStream.fail())
+    {
+        return;
+    }
+    std::string line;
+    if(inputStream.eof()) return;
+    std::getline(inputStream, line);
+    trim(line);
+    if(line.find("START: ")!=0) return;
+    line=line.substr(7);
+    start=atoi(line.c_str());
+    if(inputStream.eof()) return;
+    std::getline(inputStream, line);
+    trim(line);
+    if(line!="SYMBOLS:") return;
+    if(inputStream.eof()) return;
+    std::getline(inputStream, line);
+    int sectionsToResolve=0;
+    length=0;
+    while(true)
+    {
+        if(inputStream.eof()) return;
+        std::getline(inputStream, line);
+        trim(line);
+        if(line=="RELTAB:") break;
+        bool v;
+        Symbol s(line, v);
+        if(!v) return;
+        symbols[s.getNameId()]=s;
+        if(s.getNameId()==s.getSectionId())
+        {
+            if(StringTable::isSection(s.getNameId()))
+            {
+                sections[s.getNameId()]=s;
+                hasSection[s.getNameId()]=true;
+                if(s.getNameId()!=StringTable::BSS) sectionsToResolve+=1;
+                length+=s.getLength();
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+    if(inputStream.eof()) return;
+    std::getline(inputStream, line);
+    code=std::vector<uint8_t>(length);
+    bool raw=false;
+    while(true)
+    {
+        if(inputStream.eof()) return;
+        std::getline(inputStream, line);
+        trim(line);
+        if(line=="CODE:" || line=="CODE: RAW")
+        {
+            raw=line!="CODE:";
+            break;
+        }
+        if(line=="FRAGMENTS:")
+        {
+            if(!readFragments(inputStream, raw)) return;
+            break;
+        }
+        if(line.find("LINES:")==0)
+        {
+            if(!readLines(line, inputStream, raw)) return;
+            break;
+        }
+        bool v;
+        RelocationEntry r(line, v);
+        if(!v) return;
+        relocationEntries.push_back(r);
+    }
+    valid=true;
+    int location=0;
+    int bytesToLoad=0;
+    if(raw)
+    {
+        valid=readRawCode(inputStream, sectionsToResolve);
+        if(!valid) return;
+    }
+    while(!raw && sectionsToResolve>0)
+    {
+        if(inputStream.eof()) return;
+        std::getline(inputStream, line);
+        trim(line);
+        uint32_t sectionId;
+        if(StringTable::find(line, sectionId) && StringTable::isSection(sectionId) &&
+                sectionId!=StringTable::BSS)
+        {
+            if(bytesToLoad>0) return;
+            if(!hasSection[sectionId]) return;
+            location=sections[sectionId].getOffset();
+            bytesToLoad=sections[sectionId].getLength();
+        }
+        else
+        {
+            while(!line.empty())
+            {
+                std::string byte;
+                if(line.length()<=2)
+                {
+                    byte=line;
+                    line="";
+                }
+                else
+                {
+                    if(line[2]!=' ') return;
+                    byte=line.substr(0,2);
+                    line=line.substr(3);
+                }
+                uint8_t val=strtol(byte.c_str(), nullptr, 16);
+                bytesToLoad--;
+                if(bytesToLoad<0) return;
+                if(location-start>=code.size()) return;
+                code[location-start]=val;
+                location++;
+                if(bytesToLoad==0)
+                {
+                    sectionsToResolve--;
+                    break;
+                }
+            }
+        }
+    }
+    for(auto &symbol: symbols)
+    {
+        auto sectionId=symbol.second.getSectionId();
+        if(sectionId==StringTable::UNKNOWN) continue;
+        if(!StringTable::isSection(sectionId) || !hasSection[sectionId]) return;
+    }
+    valid=true;
+}
+void ObjectFile::trim(std::string &line, std::string additional)
+{
+    while(line.length()>0 && (std::isspace(line[0]) || additional.find(line[0])!=std::string::npos)) line.erase(0,1);
+    while(line.length()>0 && (std::isspace(line[line.length()-1]) || additional.find(line[line.length()-1])!=std::string::npos)) line.erase(line.length()-1,1);
+}
+bool ObjectFile::isValid() const
+{
+    return valid;
+}
+uint16_t ObjectFile::getStart() const
+{
+    return start;
+}
+
+uint16_t ObjectFile::getLength() const
+{
+    return length;
+}
+
+const std::string &ObjectFile::getName() const
+{
+    return name;
+}
+
+const std::unordered_map<uint32_t, Symbol> &ObjectFile::getSymbols() const
+{
+    return symbols;
+}
+
+bool ObjectFile::relocate(const SymbolTable &globalSymbols, int32_t fileDelta)
+{
+    bool ok=true;
+    for(auto &entry:relocationEntries)
+    {
+        auto local=symbols.find(entry.getTargetSymbolId());
+        if(local!=symbols.end() && !local->second.isGlobal() &&
+                local->second.getSectionId()!=StringTable::UNKNOWN)
+        {
+            ok&=relocate(entry, local->second, fileDelta);
+        }
+        else if(auto symbol=globalSymbols.find(entry.getTargetSymbolId()))
+        {
+            ok&=relocate(entry, *symbol, fileDelta);
+        }
+        if(!ok) break;
+    }
+    if(ok && fileDelta!=0) rebase(fileDelta);
+    return ok;
+}
+
+void ObjectFile::rebase(int32_t fileDelta)
+{
+    start+=fileDelta;
+    for(auto &symbol:symbols)
+    {
+        if(symbol.second.getSectionId()==StringTable::UNKNOWN) continue;
+        symbol.second.setOffset(symbol.second.getOffset()+fileDelta);
+    }
+    for(auto &section:sections)
+    {
+        section.setOffset(section.getOffset()+fileDelta);
+    }
+    for(auto &sourceLine:sourceLines)
+    {
+        sourceLine.address+=fileDelta;
+    }
+}
+
+bool ObjectFile::relocate(const RelocationEntry &entry, const Symbol &target, int32_t fileDelta)
+{
+    auto sectionId=entry.getSectionId();
+    if(!StringTable::isSection(sectionId) || !hasSection[sectionId]) return false;
+    if(sectionId==StringTable::BSS) return true;
+    auto &section=sections[sectionId];
+    if(entry.getOffset()<section.getOffset() || entry.getOffset()>=section.getOffset()+section.getLength()) return false;
+    int location=entry.getOffset()-start;
+    int32_t address=entry.getOffset()+fileDelta;
+    int length=entry.getLength();
+    if (location<0 || (size_t)(location+length)>code.size()) return false;
+    int32_t val=0;
+    int sh=0;
+    for(int i=location;i<location+length;i++)
+    {
+        val|=code[i]<<sh;
+        sh+=8;
+    }
+    if(entry.getType()==RelocationEntry::ABS)
+    {
+        if(target.isGlobal())
+        {
+            val=target.getOffset();
+        }
+        else
+        {
+            val+=fileDelta;
+        }
+    }
+    else
+    {
+        if(target.isGlobal())
+        {
+            val+=target.getOffset()-address;
+        }
+    }
+    for(int i=location;i<location+length;i++)
+    {
+        code[i]=val&(255);
+        val>>=8;
+    }
+    return true;
+}
+
+const std::vector<uint8_t> &ObjectFile::getCode() const
+{
+    return code;
+}
+
+bool ObjectFile::readRawCode(std::istream &inputStream, int sectionsToResolve)
+{
+    std::string line;
+    while(sectionsToResolve>0)
+    {
+        if(!std::getline(inputStream, line)) return false;
+        std::istringstream header(line);
+        std::string section;
+        size_t sectionLength;
+        uint32_t sectionId;
+        if(!(header>>section>>sectionLength)) return false;
+        if(!StringTable::find(section, sectionId) || !StringTable::isSection(sectionId) ||
+           sectionId==StringTable::BSS || !hasSection[sectionId]) return false;
+        auto offset=sections[sectionId].getOffset()-start;
+        if(sectionLength!=sections[sectionId].getLength() || offset<0 || offset+sectionLength>code.size()) return false;
+        if(!inputStream.read((char*)code.data()+offset, sectionLength)) return false;
+        sectionsToResolve--;
+    }
+    return true;
+}
+
+bool ObjectFile::readFragments(std::istream &inputStream, bool &raw)
+{
+    std::string line;
+    std::getline(inputStream, line);
+    while(true)
+    {
+        if(inputStream.eof()) return false;
+        std::getline(inputStream, line);
+        trim(line);
+        if(line=="CODE:" || line=="CODE: RAW")
+        {
+            raw=line!="CODE:";
+            return true;
+        }
+        if(line.find("LINES:")==0) return readLines(line, inputStream, raw);
+        std::istringstream iss(line);
+        std::string section;
+        std::string flow;
+        Fragment fragment;
+        if(!(iss>>section>>fragment.start>>fragment.length>>flow)) return false;
+        if(!StringTable::find(section, fragment.section) || !StringTable::isSection(fragment.section)) return false;
+        fragment.fallthrough=flow=="FALLTHROUGH";
+        fragments.push_back(fragment);
+    }
+}
+
+bool ObjectFile::readLines(const std::string &header, std::istream &inputStream, bool &raw)
+{
+    sourceName=header.substr(6);
+    trim(sourceName);
+    std::string line;
+    std::getline(inputStream, line);
+    while(true)
+    {
+        if(inputStream.eof()) return false;
+        std::getline(inputStream, line);
+        trim(line);
+        if(line=="CODE:" || line=="CODE: RAW")
+        {
+            raw=line!="CODE:";
+            return true;
+        }
+        std::istringstream iss(line);
+        std::string section;
+        SourceLine sourceLine;
+        if(!(iss>>section>>sourceLine.address>>sourceLine.line)) return false;
+        if(!StringTable::find(section, sourceLine.section) || !StringTable::isSection(sourceLine.section)) return false;
+        sourceLines.push_back(sourceLine);
+        int addressDelta;
+        char comma;
+        int64_t lineDelta;
+        while(iss>>addressDelta>>comma>>lineDelta)
+        {
+            if(comma!=',' || addressDelta<=0) return false;
+            sourceLine.address+=addressDelta;
+            sourceLine.line+=lineDelta;
+            sourceLines.push_back(sourceLine);
+        }
+        if(!iss.eof()) return false;
+    }
+}
+
+size_t ObjectFile::fragmentAt(uint32_t section, uint16_t address) const
+{
+    size_t found=0;
+    for(size_t i=0;i<fragments.size();i++)
+    {
+        auto &fragment=fragments[i];
+        if(fragment.section!=section) continue;
+        if(address>=fragment.start && address<fragment.start+fragment.length) return i;
+        if(address==fragment.start+fragment.length) found=i;
+    }
+    return found;
+}
+
+bool ObjectFile::isLocalTarget(const RelocationEntry &entry) const
+{
+    auto local=symbols.find(entry.getTargetSymbolId());
+    return local!=symbols.end() && !local->second.isGlobal() &&
+           local->second.getSectionId()!=StringTable::UNKNOWN;
+}
+
+uint16_t ObjectFile::targetAddress(const RelocationEntry &entry) const
+{
+    auto value=readValue(entry);
+    if(entry.getType()==RelocationEntry::REL)
+    {
+        return (uint16_t)((int16_t)value+entry.getOffset()+entry.getLength());
+    }
+    return (uint16_t)value;
+}
+
+int32_t ObjectFile::readValue(const RelocationEntry &entry) const
+{
+    int32_t val=0;
+    int sh=0;
+    for(int i=entry.getOffset()-start;i<entry.getOffset()-start+entry.getLength();i++)
+    {
+        val|=code[i]<<sh;
+        sh+=8;
+    }
+    return val;
+}
+
+void ObjectFile::writeValue(const RelocationEntry &entry, int32_t value)
+{
+    for(int i=entry.getOffset()-start;i<entry.getOffset()-start+entry.getLength();i++)
+    {
+        code[i]=value&(255);
+        value>>=8;
+    }
+}
+
+void ObjectFile::compact(const std::vector<bool> &keep)
+{
+    std::vector<size_t> order(fragments.size());
+    for(size_t i=0;i<order.size();i++) order[i]=i;
+    std::sort(order.begin(), order.end(), [this](size_t f1, size_t f2)->bool{return fragments[f1].start<fragments[f2].start;});
+    std::vector<uint16_t> newStart(fragments.size());
+    uint32_t cursor=start;
+    for(auto i:order)
+    {
+        if(!keep[i]) continue;
+        if(fragments[i].start%WORD_SIZE==0) cursor=(cursor+WORD_SIZE-1)/WORD_SIZE*WORD_SIZE;
+        newStart[i]=(uint16_t)cursor;
+        cursor+=fragments[i].length;
+    }
+    auto newAddress=[this, &newStart](uint32_t section, uint16_t address)->uint16_t
+    {
+        auto i=fragmentAt(section, address);
+        return (uint16_t)(address-fragments[i].start+newStart[i]);
+    };
+    std::vector<RelocationEntry> entries;
+    std::unordered_map<uint32_t, bool> referenced;
+    for(auto &entry:relocationEntries)
+    {
+        if(!keep[fragmentAt(entry.getSectionId(), entry.getOffset())]) continue;
+        auto newOffset=newAddress(entry.getSectionId(), entry.getOffset());
+        if(isLocalTarget(entry))
+        {
+            auto target=newAddress(entry.getTargetSymbolId(), targetAddress(entry));
+            if(entry.getType()==RelocationEntry::ABS)
+            {
+                writeValue(entry, target);
+            }
+            else
+            {
+                writeValue(entry, target-newOffset-entry.getLength());
+            }
+        }
+        referenced[entry.getTargetSymbolId()]=true;
+        entries.push_back(RelocationEntry(newOffset, entry.getTargetSymbolId(), entry.getType(),
+                                          entry.getLength(), entry.getSectionId()));
+    }
+    std::vector<uint8_t> newCode(cursor-start);
+    for(size_t i=0;i<fragments.size();i++)
+    {
+        if(!keep[i]) continue;
+        auto from=code.begin()+(fragments[i].start-start);
+        std::copy(from, from+fragments[i].length, newCode.begin()+(newStart[i]-start));
+    }
+    for(uint32_t id=0;id<StringTable::SECTION_COUNT;id++)
+    {
+        if(!hasSection[id]) continue;
+        uint32_t first=cursor;
+        uint32_t last=cursor;
+        for(auto i:order)
+        {
+            if(!keep[i] || fragments[i].section!=id) continue;
+            if(first==cursor) first=newStart[i];
+            last=newStart[i]+fragments[i].length;
+        }
+        sections[id].setOffset((uint16_t)first);
+        sections[id].setLength((uint16_t)(last-first));
+    }
+    for(auto iter=symbols.begin();iter!=symbols.end();)
+    {
+        auto &symbol=iter->second;
+        auto section=symbol.getSectionId();
+        if(section==StringTable::UNKNOWN)
+        {
+            if(referenced.count(iter->first)) iter++;
+            else iter=symbols.erase(iter);
+        }
+        else if(symbol.getNameId()==section)
+        {
+            symbol=sections[section];
+            iter++;
+        }
+        else if(keep[fragmentAt(section, symbol.getOffset())])
+        {
+            symbol.setOffset(newAddress(section, symbol.getOffset()));
+            iter++;
+        }
+        else
+        {
+            iter=symbols.erase(iter);
+        }
+    }
+    std::vector<SourceLine> keptLines;
+    for(auto &sourceLine:sourceLines)
+    {
+        if(!keep[fragmentAt(sourceLine.section, sourceLine.address)]) continue;
+        keptLines.push_back(sourceLine);
+        keptLines.back().address=newAddress(sourceLine.section, sourceLine.address);
+    }
+    sourceLines=keptLines;
+    std::vector<Fragment> kept;
+    for(auto i:order)
+    {
+        if(!keep[i]) continue;
+        kept.push_back(fragments[i]);
+        kept.back().start=newStart[i];
+    }
+    relocationEntries=entries;
+    fragments=kept;
+    code=newCode;
+    length=(uint16_t)(cursor-start);
+}
+
+const std::vector<RelocationEntry> &ObjectFile::getRelocationEntries() const
+{
+    return relocationEntries;
+}
+
+const std::vector<ObjectFile::Fragment> &ObjectFile::getFragments() const
+{
+    return fragments;
+}
+
+const std::string &ObjectFile::getSourceName() const
+{
+    return sourceName;
+}
+
+const std::vector<ObjectFile::SourceLine> &ObjectFile::getSourceLines() const
+{
+    return sourceLines;
+}
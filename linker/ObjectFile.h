@@ -0,0 +1,86 @@
+//
+// Created by nidzo on 20.5.18..
+//
+
+#ifndef SS_OBJECTFILE_H
+#define SS_OBJECTFILE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../common/Symbol.h"
+#include "../common/RelocationEntry.h"
+#include "SymbolTable.h"
+#include "../common/StringTable.h"
+#include "../common/machine_params.h"
+
+class ObjectFile
+{
+public:
+    struct Fragment
+    {
+        uint32_t section;
+        uint16_t start;
+        uint16_t length;
+        bool fallthrough;
+    };
+    struct SourceLine
+    {
+        uint32_t section;
+        uint16_t address;
+        uint32_t line;
+    };
+
+    ObjectFile();
+    ObjectFile(std::istream &inputStream, const std::string &fileName);
+    static void trim(std::string &line, std::string additional="");
+    bool relocate(const SymbolTable &globalSymbols, int32_t fileDelta);
+    size_t fragmentAt(uint32_t section, uint16_t address) const;
+    bool isLocalTarget(const RelocationEntry &entry) const;
+    uint16_t targetAddress(const RelocationEntry &entry) const;
+    void compact(const std::vector<bool> &keep);
+protected:
+    bool valid;
+    bool relocate(const RelocationEntry &entry, const Symbol &target, int32_t fileDelta);
+    void rebase(int32_t fileDelta);
+    std::unordered_map<uint32_t, Symbol> symbols;
+    Symbol sections[StringTable::SECTION_COUNT];
+    bool hasSection[StringTable::SECTION_COUNT];
+    std::vector<RelocationEntry> relocationEntries;
+    std::vector<Fragment> fragments;
+    bool readFragments(std::istream &inputStream, bool &raw);
+    bool readLines(const std::string &header, std::istream &inputStream, bool &raw);
+    std::string sourceName;
+    std::vector<SourceLine> sourceLines;
+    bool readRawCode(std::istream &inputStream, int sectionsToResolve);
+    int32_t readValue(const RelocationEntry &entry) const;
+    void writeValue(const RelocationEntry &entry, int32_t value);
+    std::vector<uint8_t> code;
+    uint16_t start;
+    uint16_t length;
+    std::string name;
+public:
+    bool isValid() const;
+
+    uint16_t getStart() const;
+
+    uint16_t getLength() const;
+
+    const std::string &getName() const;
+
+    const std::unordered_map<uint32_t, Symbol> &getSymbols() const;
+
+    const std::vector<uint8_t> &getCode() const;
+
+    const std::vector<RelocationEntry> &getRelocationEntries() const;
+
+    const std::vector<Fragment> &getFragments() const;
+
+    const std::string &getSourceName() const;
+
+    const std::vector<SourceLine> &getSourceLines() const;
+};
+
+
+#endif //SS_OBJECTFILE_H
@@ -0,0 +1,90 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <algorithm>
+#include "SymbolTable.h"
+#include "../common/StringTable.h"
+
+void SymbolTable::insert(uint32_t name, const Symbol &symbol, size_t fileIndex)
+{
+    auto &shard=shardFor(name);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto iter=shard.symbols.find(name);
+    if(iter==shard.symbols.end())
+    {
+        shard.symbols.insert({name, {symbol, fileIndex}});
+        return;
+    }
+    if(fileIndex<iter->second.fileIndex)
+    {
+        shard.duplicates.push_back({name, iter->second.fileIndex});
+        iter->second={symbol, fileIndex};
+    }
+    else
+    {
+        shard.duplicates.push_back({name, fileIndex});
+    }
+}
+
+const Symbol *SymbolTable::find(const std::string &name) const
+{
+    uint32_t id;
+    if(!StringTable::find(name, id)) return nullptr;
+    return find(id);
+}
+
+const Symbol *SymbolTable::find(uint32_t name) const
+{
+    auto &shard=shardFor(name);
+    auto iter=shard.symbols.find(name);
+    if(iter==shard.symbols.end()) return nullptr;
+    return &iter->second.symbol;
+}
+
+std::vector<SymbolTable::Duplicate> SymbolTable::getDuplicates() const
+{
+    std::vector<Duplicate> duplicates;
+    for(auto &shard:shards)
+    {
+        duplicates.insert(duplicates.end(), shard.duplicates.begin(), shard.duplicates.end());
+    }
+    std::sort(duplicates.begin(), duplicates.end(), [](const Duplicate &d1, const Duplicate &d2)->bool
+    {
+        if(d1.fileIndex!=d2.fileIndex) return d1.fileIndex<d2.fileIndex;
+        return StringTable::lookup(d1.name)<StringTable::lookup(d2.name);
+    });
+    return duplicates;
+}
+
+std::unordered_map<uint32_t, Symbol> SymbolTable::getSymbols() const
+{
+    std::unordered_map<uint32_t, Symbol> symbols;
+    for(auto &shard:shards)
+    {
+        for(auto &entry:shard.symbols)
+        {
+            symbols[entry.first]=entry.second.symbol;
+        }
+    }
+    return symbols;
+}
+
+void SymbolTable::clear()
+{
+    for(auto &shard:shards)
+    {
+        shard.symbols.clear();
+        shard.duplicates.clear();
+    }
+}
+
+SymbolTable::Shard &SymbolTable::shardFor(uint32_t name)
+{
+    return shards[name%SYMBOL_TABLE_SHARDS];
+}
+
+const SymbolTable::Shard &SymbolTable::shardFor(uint32_t name) const
+{
+    return shards[name%SYMBOL_TABLE_SHARDS];
+}
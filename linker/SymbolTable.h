@@ -0,0 +1,55 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#ifndef SS_SYMBOLTABLE_H
+#define SS_SYMBOLTABLE_H
+
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/Symbol.h"
+
+#define SYMBOL_TABLE_SHARDS 16
+
+// Global symbol table that several files can be merged into concurrently.
+// When two files define the same symbol, the definition from the file with
+// the lowest index wins and the clash is recorded, so the result does not
+// depend on thread scheduling.
+class SymbolTable
+{
+public:
+    struct Duplicate
+    {
+        uint32_t name;
+        size_t fileIndex;
+    };
+
+    void insert(uint32_t name, const Symbol &symbol, size_t fileIndex);
+    const Symbol *find(uint32_t name) const;
+    const Symbol *find(const std::string &name) const;
+    std::vector<Duplicate> getDuplicates() const;
+    std::unordered_map<uint32_t, Symbol> getSymbols() const;
+    void clear();
+
+protected:
+    struct Entry
+    {
+        Symbol symbol;
+        size_t fileIndex;
+    };
+    struct Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<uint32_t, Entry> symbols;
+        std::vector<Duplicate> duplicates;
+    };
+    Shard &shardFor(uint32_t name);
+    const Shard &shardFor(uint32_t name) const;
+    Shard shards[SYMBOL_TABLE_SHARDS];
+};
+
+
+#endif //SS_SYMBOLTABLE_H
@@ -0,0 +1,9 @@
+# Runs TOOL on INPUT and compares its output with EXPECTED
+execute_process(COMMAND ${TOOL} ${INPUT} OUTPUT_FILE ${OUTPUT} RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "${TOOL} failed on ${INPUT}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED} RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "Output for ${INPUT} differs from ${EXPECTED}, see ${OUTPUT}")
+endif()
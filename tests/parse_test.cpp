@@ -0,0 +1,127 @@
+//
+// Created by nidzo on 19.10.26..
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "assembler/File.h"
+
+// Prints what Line and Operand make of every source line, for the golden
+// tests. With -b REPEAT the files are parsed REPEAT times instead and the
+// throughput is printed.
+
+template<class Text>
+std::string text(const Text &value)
+{
+    return std::string(value.begin(), value.end());
+}
+
+void dumpOperand(const Operand &operand, std::ostream &stream)
+{
+    auto type=operand.getType();
+    stream<<" ["<<(int)type;
+    if(type==Operand::ABS_VAL || type==Operand::MEMDIR || type==Operand::REGISTER_OFFS_ABS)
+    {
+        stream<<" value "<<operand.getNumericValue();
+    }
+    if(type==Operand::REGISTER || type==Operand::REGISTER_OFFS_ABS || type==Operand::REGISTER_OFFS_SYM ||
+       type==Operand::PCREL)
+    {
+        stream<<" r"<<operand.getRegisterId();
+    }
+    if(type==Operand::SYMB_VAL || type==Operand::SYMB || type==Operand::REGISTER_OFFS_SYM || type==Operand::PCREL)
+    {
+        stream<<" "<<text(operand.getSymbol());
+    }
+    stream<<"]";
+}
+
+bool dump(const std::string &fileName, std::ostream &stream)
+{
+    std::ifstream ifs(fileName);
+    if(!ifs.is_open())
+    {
+        std::cerr<<"Failed to open input file "<<fileName<<"\n";
+        return false;
+    }
+    File file(ifs, fileName);
+    for(auto &line:file.getLines())
+    {
+        stream<<line.getNumber()<<" "<<(int)line.getType()<<" "<<line.isValid()<<" |"<<text(line.getLabel())<<"|"
+              <<text(line.getInstruction())<<"|"<<text(line.getDirective())<<"|"<<text(line.getDotArg())<<"|";
+        dumpOperand(line.getArg0(), stream);
+        dumpOperand(line.getArg1(), stream);
+        stream<<"\n";
+    }
+    for(auto &error:file.getErrors())
+    {
+        stream<<"error "<<error<<"\n";
+    }
+    return true;
+}
+
+bool bench(const std::vector<std::string> &fileNames, unsigned repeat)
+{
+    std::vector<std::string> sources;
+    for(auto &fileName:fileNames)
+    {
+        std::ifstream ifs(fileName);
+        std::stringstream buffer;
+        buffer<<ifs.rdbuf();
+        if(ifs.fail())
+        {
+            std::cerr<<"Failed to open input file "<<fileName<<"\n";
+            return false;
+        }
+        sources.push_back(buffer.str());
+    }
+    size_t lines=0;
+    auto begin=std::chrono::steady_clock::now();
+    for(unsigned r=0;r<repeat;r++)
+    {
+        for(size_t i=0;i<sources.size();i++)
+        {
+            std::istringstream iss(sources[i]);
+            File file(iss, fileNames[i]);
+            lines+=file.getLines().size();
+        }
+    }
+    double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+    std::cout<<"{\"lines\": "<<lines<<", \"seconds\": "<<seconds<<", \"lines_per_second\": "
+             <<(long)(lines/seconds)<<"}\n";
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned repeat=0;
+    int opt;
+    while((opt=getopt(argc, argv, "b:"))!=-1)
+    {
+        if(opt=='?')
+        {
+            std::cerr<<"Format "<<argv[0]<<" [-b REPEAT] input_files...\n";
+            std::cerr<<"Arguments:\n-b REPEAT (optional, parse the files REPEAT times and print lines per second)";
+            return -1;
+        }
+        if(opt=='b') repeat=(unsigned)atoi(optarg);
+    }
+    if(argc<=optind)
+    {
+        std::cerr<<"No input files given\n";
+        return -1;
+    }
+    std::vector<std::string> fileNames(argv+optind, argv+argc);
+    if(repeat>0) return bench(fileNames, repeat) ? 0 : -1;
+    for(auto &fileName:fileNames)
+    {
+        if(!dump(fileName, std::cout)) return -1;
+    }
+    return 0;
+}